@@ -4,9 +4,16 @@
 #include <GL/glut.h>
 #include <GL/gl.h>
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
+#include "c64_headless.h"
+#include "c64_precalc.h"
+#include "c64_projection.h"
+#include "c64_readback.h"
+#include "c64_shapes.h"
+
 #include <glm/vec3.hpp>
 
 using namespace std;
@@ -14,46 +21,31 @@ using namespace std;
 static const int FPS = 60;
 static GLint rotateAngle = 0;
 static GLint rotateAngle2 = 0;
+static FrameReadback pixelReadback;
+
+// --precalc: one loop of projected coordinates for the C64 (see c64_precalc.h)
+static const int LOOP_FRAMES = 180;  // rotateAngle += 2 per frame
+static PrecalcOptions precalc;
+static PrecalcTable precalcTable;
+static int frameIndex = 0;
 
 //- Cube Namespace
 namespace Cube {
 
-    const int NUM_CUBE_VERTICES = 54;
-    const int NUM_PYRAMID_APEXES = 6;
+    // 3x3 points on each face of a 5x5x5 grid, generated while compiling
+    // (see c64_shapes.h; tools/shape-tables writes the same points for the C64)
+    constexpr auto MODEL = shapes::generate<shapes::CUBE_GRID.count()>(shapes::CUBE_GRID);
+    constexpr auto vertices = shapes::truncated(MODEL);
 
-    GLint vertices[NUM_CUBE_VERTICES][3] = {
-      { -2,   0,   0}, { -2,  -1,   0}, { -2,   0,  -1}, { -2,   0,   1},
-      { -2,   1,   0}, { -2,  -1,  -1}, { -2,  -1,   1}, { -2,   1,  -1},
-      { -2,   1,   1}, { -1,  -2,   0}, { -1,  -2,  -1}, { -1,  -2,   1},
-      { -1,  -1,  -2}, { -1,  -1,   2}, { -1,   0,  -2}, { -1,   0,   2},
-      { -1,   1,  -2}, { -1,   1,   2}, { -1,   2,  -1}, { -1,   2,   1},
-      { -1,   2,   0}, {  0,  -2,   0}, {  0,   0,  -2}, {  0,   0,   2},
-      {  0,   2,   0}, {  0,  -2,  -1}, {  0,  -2,   1}, {  0,  -1,  -2},
-      {  0,  -1,   2}, {  0,   1,  -2}, {  0,   1,   2}, {  0,   2,  -1},
-      {  0,   2,   1}, {  1,  -2,  -1}, {  1,  -2,   1}, {  1,  -1,  -2},
-      {  1,  -1,   2}, {  1,   1,  -2}, {  1,   1,   2}, {  1,   2,  -1},
-      {  1,   2,   1}, {  1,  -2,   0}, {  1,   0,  -2}, {  1,   0,   2},
-      {  1,   2,   0}, {  2,  -1,  -1}, {  2,  -1,   1}, {  2,   1,  -1},
-      {  2,   1,   1}, {  2,  -1,   0}, {  2,   0,  -1}, {  2,   0,   1},
-      {  2,   1,   0}, {  2,   0,   0}
-    };
-
-    GLfloat vertexColors[NUM_CUBE_VERTICES][3] = {
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1},
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1},
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1},
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1},
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1},
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1},
-      {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}, {1, 1, 1}
-    }
+    const int NUM_CUBE_VERTICES = MODEL.size();
+    const int NUM_PYRAMID_APEXES = 6;
 
     void draw() {
       // Draw rhombicosidodecahedron vertices as points
       glBegin(GL_POINTS);
       for (int i = 0; i < NUM_CUBE_VERTICES; i++) {
-        glColor3fv((GLfloat*)&vertexColors[i]);
-        glVertex3iv((GLint*)&vertices[i]);
+        glColor3fv(&MODEL[i].r);
+        glVertex3iv(&vertices[i].x);
       }
       glEnd();
     }
@@ -68,54 +60,60 @@ void display() {
     Cube::draw();
     rotateAngle += 2;
     
-    GLdouble retX, retY, retZ;
-
-    //- Get Pixel Data
+    //- Get Pixel Data (arrives a few frames late, without stalling the pipeline)
     GLubyte pixels[3];
-    glReadPixels(50, 50, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, &pixels);
-    cout << "Pixel R:" << static_cast<int>(pixels[0]) << " G:"  << static_cast<int>(pixels[1]) << " B:" << static_cast<int>(pixels[2]) << endl;
-
-    //- Project all rhombicosidodecahedron vertices to window coordinates using gluProject
-    GLdouble modelview[16];
-    GLdouble projection[16];
-    GLint viewport[4];
-    
-    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-    glGetDoublev(GL_PROJECTION_MATRIX, projection);
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    
-    GLdouble projectedCoords[Cube::NUM_CUBE_VERTICES][3];
-    
-    for (int i = 0; i < Cube::NUM_CUBE_VERTICES; i++) {
-        gluProject(
-            (GLdouble)Cube::vertices[i][0], 
-            (GLdouble)Cube::vertices[i][1], 
-            (GLdouble)Cube::vertices[i][2],
-            modelview, 
-            projection, 
-            viewport,
-            &projectedCoords[i][0], 
-            &projectedCoords[i][1], 
-            &projectedCoords[i][2]
-        );
-        cout << "Vertex " << i << " -> Window coords: (" 
-             << projectedCoords[i][0] << ", " 
-             << projectedCoords[i][1] << ", " 
-             << projectedCoords[i][2] << ")" << endl;
+    if (pixelReadback.full() && pixelReadback.collect(pixels)) {
+        cout << "Pixel R:" << static_cast<int>(pixels[0]) << " G:"  << static_cast<int>(pixels[1]) << " B:" << static_cast<int>(pixels[2]) << endl;
     }
+    pixelReadback.begin(0);
+
+    //- Project all vertices to C64 screen coordinates (row 0 at the top)
+    Projection projection;
+    projection_from_gl(&projection);
+
+    // The grid lies on whole units, so the float model is the drawn integer one
+    int16_t screenX[Cube::NUM_CUBE_VERTICES];
+    int16_t screenY[Cube::NUM_CUBE_VERTICES];
+    project_vertices_c64(projection, &Cube::MODEL[0].x, sizeof(shapes::Vertex) / sizeof(float),
+                         Cube::NUM_CUBE_VERTICES, 0, 0, screenX, screenY, NULL);
+
+    //- Print them, or collect them for the C64 data tables (--precalc)
+    if (!precalc.enabled) {
+        for (int i = 0; i < Cube::NUM_CUBE_VERTICES; i++) {
+            cout << "Vertex " << i << " -> Screen coords: (" 
+                 << screenX[i] << ", " 
+                 << screenY[i] << ")" << endl;
+        }
+    } else if (frameIndex < precalcTable.frames()) {
+        precalcTable.record(frameIndex, screenX, screenY, NULL);
+    }
+    frameIndex++;
 
     glPopMatrix();
     glFlush();
 
-    glutSwapBuffers();
+    present_frame();
 }
 
-void timer(int v) {
+// One animation step: what the GLUT timer does between two frames
+void advance() {
   //static GLfloat u = 4.74;
   static GLfloat u = 4.74;
   //u += 0.03;
   glLoadIdentity();
   gluLookAt(8*cos(u), 7*cos(u)-1, 4*cos(u/3)+2, .5, .5, .5, cos(u), 1, 0);
+}
+
+// End of a headless run: write the collected loop (false if that failed)
+bool finish() {
+  if (!precalc.enabled) {
+    return true;
+  }
+  return write_precalc_report(precalcTable, string("cube_grid_") + raster_name(precalc.raster), "cube_grid", precalc);
+}
+
+void timer(int v) {
+  advance();
   glutPostRedisplay();
   glutTimerFunc(1000/FPS, timer, v);
 }
@@ -131,9 +129,33 @@ void reshape(int w, int h) {
 void init() {
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
+  pixelReadback.init(50, 50, 1, 1, 3);
 }
 
 int main(int argc, char** argv) {
+  // --headless FRAMES renders without a window, see c64_headless.h
+  HeadlessOptions headless;
+  if (!parse_headless_args(&argc, argv, &headless)) {
+    return 1;
+  }
+  // --precalc sprite|char renders one loop headless and writes it as C64 data
+  if (!parse_precalc_args(&argc, argv, &precalc)) {
+    return 1;
+  }
+  if (precalc.enabled) {
+    precalc.screen_width = 96;
+    precalc.screen_height = 80;
+    if (headless.frames == 0) {
+      headless.frames = LOOP_FRAMES;
+    }
+    precalcTable.resize(min(headless.frames, LOOP_FRAMES), Cube::NUM_CUBE_VERTICES);
+  }
+
+  if (headless.frames > 0) {
+    HeadlessScene scene = {reshape, init, display, advance, finish};
+    return run_headless(headless, 96, 80, scene);
+  }
+
   glutInit(&argc, argv);
   glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
   glutInitWindowSize(96, 80);
@@ -4,9 +4,16 @@
 #include <GL/glut.h>
 #include <GL/gl.h>
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
+#include "c64_headless.h"
+#include "c64_precalc.h"
+#include "c64_projection.h"
+#include "c64_readback.h"
+#include "c64_shapes.h"
+
 #include <glm/vec3.hpp>
 
 using namespace std;
@@ -14,65 +21,34 @@ using namespace std;
 static const int FPS = 60;
 static GLfloat rotateAngle = 0.0f;
 static GLint rotateAngle2 = 0;
+static FrameReadback pixelReadback;
+
+// --precalc: one loop of projected coordinates for the C64 (see c64_precalc.h)
+static const int LOOP_FRAMES = 90;  // rotateAngle += 4 per frame
+static PrecalcOptions precalc;
+static PrecalcTable precalcTable;
+static int frameIndex = 0;
 
 namespace DoubleHelix {
 
-    const int NUM_VERTICES = 32;
-    GLint vertices[NUM_VERTICES][3];
-    GLfloat vertexColors[NUM_VERTICES][3];
+    // Two strands of 16 points, generated while compiling (see c64_shapes.h;
+    // tools/shape-tables writes the same points for the C64)
+    constexpr auto MODEL = shapes::generate<shapes::CYLINDER_HELIX.count()>(shapes::CYLINDER_HELIX);
+    constexpr auto vertices = shapes::truncated(MODEL);
+
+    const int NUM_VERTICES = MODEL.size();
 
     void draw() {
       // Draw double helix vertices as points (stay in pixel draw mode - do NOT connect)
       glBegin(GL_POINTS);
       for (int i = 0; i < NUM_VERTICES; i++) {
-        glColor3fv((GLfloat*)&vertexColors[i]);
-        glVertex3iv((GLint*)&vertices[i]);
+        glColor3fv(&MODEL[i].r);
+        glVertex3iv(&vertices[i].x);
       }
       glEnd();
     }
 }
 
-void generateDoubleHelix() {
-
-  const float radius = 2.0f;
-  const float height = 30.0f;
-  const int pointsPerHelix = DoubleHelix::NUM_VERTICES/2;
-
-  int coordIndex = 0;
-
-  for (int i = 0; i < pointsPerHelix; i++) {
-
-      float t = (float)i / (float)(pointsPerHelix - 1);
-      float angle = t * 4.0f * M_PI;
-
-      DoubleHelix::vertices[coordIndex][0] = radius * cos(angle) *2;
-      DoubleHelix::vertices[coordIndex][1] = radius * sin(angle) *2;
-      DoubleHelix::vertices[coordIndex][2] = -height/2 + height * t *2;
-
-      DoubleHelix::vertexColors[coordIndex][0] = 1;
-      DoubleHelix::vertexColors[coordIndex][1] = 1;
-      DoubleHelix::vertexColors[coordIndex][2] = 1;
-
-      coordIndex += 1;
-  }
-
-  for (int i = 0; i < pointsPerHelix; i++) {
-
-      float t = (float)i / (float)(pointsPerHelix - 1);
-      float angle = t * 4.0f * M_PI + M_PI;
-
-      DoubleHelix::vertices[coordIndex][0] = radius * cos(angle) *2;
-      DoubleHelix::vertices[coordIndex][1] = radius * sin(angle) *2;
-      DoubleHelix::vertices[coordIndex][2] = -height/2 + height * t *2;
-
-      DoubleHelix::vertexColors[coordIndex][0] = 1;
-      DoubleHelix::vertexColors[coordIndex][1] = 1;
-      DoubleHelix::vertexColors[coordIndex][2] = 1;
-
-      coordIndex += 1;
-  }
-}
-
 void display() {
 
     glClear(GL_COLOR_BUFFER_BIT);
@@ -90,45 +66,43 @@ void display() {
     if (rotateAngle >= 360.0f) rotateAngle -= 360.0f;
     */
 
-    GLdouble retX, retY, retZ;
-
-    //- Get Pixel Data
+    //- Get Pixel Data (arrives a few frames late, without stalling the pipeline)
     GLubyte pixels[3];
-    glReadPixels(50, 50, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, &pixels);
-    //cout << "Pixel R:" << static_cast<int>(pixels[0]) << " G:"  << static_cast<int>(pixels[1]) << " B:" << static_cast<int>(pixels[2]) << endl;
+    if (pixelReadback.full()) {
+        pixelReadback.collect(pixels);
+        //cout << "Pixel R:" << static_cast<int>(pixels[0]) << " G:"  << static_cast<int>(pixels[1]) << " B:" << static_cast<int>(pixels[2]) << endl;
+    }
+    pixelReadback.begin(0);
 
-    //- Project all double helix vertices to window coordinates using gluProject
-    GLdouble modelview[16];
-    GLdouble projection[16];
-    GLint viewport[4];
+    //- Project all vertices to C64 screen coordinates (row 0 at the top)
+    Projection projection;
+    projection_from_gl(&projection);
 
-    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-    glGetDoublev(GL_PROJECTION_MATRIX, projection);
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    float coords[DoubleHelix::NUM_VERTICES][3];
+    for (int i = 0; i < DoubleHelix::NUM_VERTICES; i++) {
+        coords[i][0] = (float)DoubleHelix::vertices[i].x;
+        coords[i][1] = (float)DoubleHelix::vertices[i].y;
+        coords[i][2] = (float)DoubleHelix::vertices[i].z;
+    }
 
-    GLdouble projectedCoords[DoubleHelix::NUM_VERTICES][3];
+    int16_t screenX[DoubleHelix::NUM_VERTICES];
+    int16_t screenY[DoubleHelix::NUM_VERTICES];
+    project_vertices_c64(projection, &coords[0][0], 3, DoubleHelix::NUM_VERTICES, 0, 0, screenX, screenY, NULL);
 
-    for (int i = 0; i < DoubleHelix::NUM_VERTICES; i++) {
-        gluProject(
-            (GLdouble)DoubleHelix::vertices[i][0],
-            (GLdouble)DoubleHelix::vertices[i][1],
-            (GLdouble)DoubleHelix::vertices[i][2],
-            modelview, 
-            projection,
-            viewport,
-            &projectedCoords[i][0], 
-            &projectedCoords[i][1], 
-            &projectedCoords[i][2]
-        );
+    //- Collect them for the C64 data tables (--precalc)
+    if (precalc.enabled && frameIndex < precalcTable.frames()) {
+        precalcTable.record(frameIndex, screenX, screenY, NULL);
     }
+    frameIndex++;
 
     glPopMatrix();
     glFlush();
 
-    glutSwapBuffers();
+    present_frame();
 }
 
-void timer(int v) {
+// One animation step: what the GLUT timer does between two frames
+void advance() {
   glLoadIdentity();
   // Position camera with angled view: cylinder farther in z at top, closer at bottom
   // Eye positioned at an angle to create perspective effect
@@ -136,6 +110,18 @@ void timer(int v) {
   gluLookAt(0.0, 35.0, 55.0,     // Eye position (slightly above, far back)
             0.0, 0.0, 0.0,       // Look at center of double helix
             0.0, -4.0, 0.0);      // Up vector
+}
+
+// End of a headless run: write the collected loop (false if that failed)
+bool finish() {
+  if (!precalc.enabled) {
+    return true;
+  }
+  return write_precalc_report(precalcTable, string("helix_") + raster_name(precalc.raster), "helix", precalc);
+}
+
+void timer(int v) {
+  advance();
   glutPostRedisplay();
   glutTimerFunc(1000/FPS, timer, v);
 }
@@ -153,10 +139,33 @@ void reshape(int w, int h) {
 void init() {
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
+  pixelReadback.init(50, 50, 1, 1, 3);
 }
 
 int main(int argc, char** argv) {
-  generateDoubleHelix();
+  // --headless FRAMES renders without a window, see c64_headless.h
+  HeadlessOptions headless;
+  if (!parse_headless_args(&argc, argv, &headless)) {
+    return 1;
+  }
+  // --precalc sprite|char renders one loop headless and writes it as C64 data
+  if (!parse_precalc_args(&argc, argv, &precalc)) {
+    return 1;
+  }
+  if (precalc.enabled) {
+    precalc.screen_width = 42;
+    precalc.screen_height = 252;
+    if (headless.frames == 0) {
+      headless.frames = LOOP_FRAMES;
+    }
+    precalcTable.resize(min(headless.frames, LOOP_FRAMES), DoubleHelix::NUM_VERTICES);
+  }
+
+  if (headless.frames > 0) {
+    HeadlessScene scene = {reshape, init, display, advance, finish};
+    return run_headless(headless, 42, 252, scene);
+  }
+
   glutInit(&argc, argv);
   glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
   //glutInitWindowSize(420, 2520);
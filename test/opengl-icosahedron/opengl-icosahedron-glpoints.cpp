@@ -6,6 +6,11 @@
 #include <cmath>
 #include <iostream>
 
+#include "c64_headless.h"
+#include "c64_precalc.h"
+#include "c64_projection.h"
+#include "c64_shapes.h"
+
 using namespace std;
 
 static const int FPS = 60;
@@ -17,30 +22,22 @@ static float rotateX = 0.0f;
 static float rotateY = 0.0f;
 static float rotateZ = 0.0f;
 
+// --precalc: the 180 frame rotation as C64 data (see c64_precalc.h), on a
+// 320x200 screen so --dedup can find the frames the symmetry repeats
+static const int PRECALC_WIDTH = 320;
+static const int PRECALC_HEIGHT = 200;
+static PrecalcOptions precalc;
+static PrecalcTable precalcTable;
+static int frameIndex = 0;
+
 namespace Icosahedron {
     // 12 vertices of an icosahedron with INTEGER coordinates
-    // Based on the golden ratio positions, scaled and rounded to integers
-    // Original coordinates use PHI = (1 + sqrt(5)) / 2 ≈ 1.618
-    // We scale by a factor to get reasonable integer values
-    // Using a scale factor of ~62 gives good integer approximations:
-    // PHI * 62 ≈ 100, 1 * 62 = 62, 0 * 62 = 0
-    const int NUM_VERTICES = 12;
-    const int SCALE = 62;  // Scale factor for conversion to integer
-    
-    GLint vertices[NUM_VERTICES][3] = {
-        {-62,  100,  0},   // 0:  (-1,  PHI,  0)
-        { 62,  100,  0},   // 1:  ( 1,  PHI,  0)
-        {-62, -100,  0},   // 2:  (-1, -PHI,  0)
-        { 62, -100,  0},   // 3:  ( 1, -PHI,  0)
-        {  0,  -62, 100},  // 4:  ( 0,  -1,  PHI)
-        {  0,   62, 100},  // 5:  ( 0,   1,  PHI)
-        {  0,  -62,-100},  // 6:  ( 0,  -1, -PHI)
-        {  0,   62,-100},  // 7:  ( 0,   1, -PHI)
-        {100,    0, -62},  // 8:  ( PHI,  0,  -1)
-        {100,    0,  62},  // 9:  ( PHI,  0,   1)
-        {-100,   0, -62},  // 10: (-PHI,  0,  -1)
-        {-100,   0,  62}   // 11: (-PHI,  0,   1)
-    };
+    // The golden ratio positions (0, +-1, +-PHI) scaled by 62 and rounded:
+    // PHI * 62 = 100.3, so the vertices are made of 0, 62 and 100.
+    // Generated while compiling, see c64_shapes.h
+    constexpr auto vertices = shapes::rounded(shapes::generate<12>(shapes::ICOSAHEDRON));
+
+    const int NUM_VERTICES = vertices.size();
     
     void draw() {
         // Set point size for better visibility
@@ -52,7 +49,7 @@ namespace Icosahedron {
         // Draw all 12 vertices as points
         glBegin(GL_POINTS);
         for (int i = 0; i < NUM_VERTICES; i++) {
-            glVertex3i(vertices[i][0], vertices[i][1], vertices[i][2]);
+            glVertex3iv(&vertices[i].x);
         }
         glEnd();
     }
@@ -75,10 +72,32 @@ void display() {
     // Draw the icosahedron as points
     Icosahedron::draw();
 
-    glutSwapBuffers();
+    // Project the drawn integer vertices to C64 screen coordinates
+    if (precalc.enabled && frameIndex < precalcTable.frames()) {
+        Projection projection;
+        projection_from_gl(&projection);
+
+        float x[Icosahedron::NUM_VERTICES];
+        float y[Icosahedron::NUM_VERTICES];
+        float z[Icosahedron::NUM_VERTICES];
+        for (int i = 0; i < Icosahedron::NUM_VERTICES; i++) {
+            x[i] = (float)Icosahedron::vertices[i].x;
+            y[i] = (float)Icosahedron::vertices[i].y;
+            z[i] = (float)Icosahedron::vertices[i].z;
+        }
+        int16_t screenX[Icosahedron::NUM_VERTICES];
+        int16_t screenY[Icosahedron::NUM_VERTICES];
+        unsigned char visible[Icosahedron::NUM_VERTICES];
+        project_points_c64(projection, x, y, z, Icosahedron::NUM_VERTICES, 0, 0, screenX, screenY, visible);
+        precalcTable.record(frameIndex, screenX, screenY, visible);
+    }
+    frameIndex++;
+
+    present_frame();
 }
 
-void timer(int value) {
+// One animation step: what the GLUT timer does between two frames
+void advance() {
     // Update frame counter
     frameCounter++;
     
@@ -94,7 +113,19 @@ void timer(int value) {
     if (frameCounter >= TOTAL_FRAMES) {
         frameCounter = 0;
     }
+}
+
+// End of a headless run: write the collected rotation (false if that failed)
+bool finish() {
+    if (!precalc.enabled) {
+        return true;
+    }
+    return write_precalc_report(precalcTable, string("icosahedron_") + raster_name(precalc.raster), "icosahedron",
+                                precalc);
+}
 
+void timer(int value) {
+    advance();
     glutPostRedisplay();
     glutTimerFunc(1000 / FPS, timer, 0);
 }
@@ -121,6 +152,34 @@ void init() {
 }
 
 int main(int argc, char** argv) {
+    // --headless FRAMES renders without a window, see c64_headless.h
+    HeadlessOptions headless;
+    if (!parse_headless_args(&argc, argv, &headless)) {
+        return 1;
+    }
+    // --precalc sprite|char renders the rotation headless and writes it as C64 data
+    if (!parse_precalc_args(&argc, argv, &precalc)) {
+        return 1;
+    }
+    if (precalc.enabled) {
+        precalc.screen_width = PRECALC_WIDTH;
+        precalc.screen_height = PRECALC_HEIGHT;
+        if (headless.frames == 0) {
+            headless.frames = TOTAL_FRAMES;
+        }
+        // Every rendered frame is recorded: with --headless 360 and --dedup
+        // the two recorded turns come back as one loop of TOTAL_FRAMES
+        precalcTable.resize(headless.frames, Icosahedron::NUM_VERTICES);
+    }
+
+    if (headless.frames > 0) {
+        HeadlessScene scene = {reshape, init, display, advance, finish};
+        if (precalc.enabled) {
+            return run_headless(headless, PRECALC_WIDTH, PRECALC_HEIGHT, scene);
+        }
+        return run_headless(headless, 800, 600, scene);
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
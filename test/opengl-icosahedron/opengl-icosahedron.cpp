@@ -6,6 +6,8 @@
 #include <cmath>
 #include <iostream>
 
+#include "c64_headless.h"
+
 using namespace std;
 
 static const int FPS = 60;
@@ -219,10 +221,11 @@ void display() {
     // Draw the icosahedron
     Icosahedron::draw();
 
-    glutSwapBuffers();
+    present_frame();
 }
 
-void timer(int value) {
+// One animation step: what the GLUT timer does between two frames
+void advance() {
     // Update frame counter
     frameCounter++;
     
@@ -238,7 +241,10 @@ void timer(int value) {
     if (frameCounter >= TOTAL_FRAMES) {
         frameCounter = 0;
     }
+}
 
+void timer(int value) {
+    advance();
     glutPostRedisplay();
     glutTimerFunc(1000 / FPS, timer, 0);
 }
@@ -271,6 +277,17 @@ void init() {
 }
 
 int main(int argc, char** argv) {
+    // --headless FRAMES renders without a window, see c64_headless.h
+    HeadlessOptions headless;
+    if (!parse_headless_args(&argc, argv, &headless)) {
+        return 1;
+    }
+
+    if (headless.frames > 0) {
+        HeadlessScene scene = {reshape, init, display, advance, NULL};
+        return run_headless(headless, 800, 600, scene);
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
@@ -12,168 +12,142 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "c64_correspondence.h"
+#include "c64_headless.h"
+#include "c64_morph.h"
+#include "c64_precalc.h"
+#include "c64_projection.h"
+#include "c64_readback.h"
+#include "c64_shapes.h"
+#include "ring_buffer.h"
 
 using namespace std;
 
 static const int FPS = 10;  // 10 frames per second
-static const int NUM_VERTICES = 64;
+static const int WIDTH = 800;
+static const int HEIGHT = 600;
 static const int FRAMES_PER_LOOP = 180;  // Each animation loops in 180 frames
 static const int LOOPS_BEFORE_MORPH = 3;  // Loop 3 times before morphing
 static const int FRAMES_PER_MODEL = FRAMES_PER_LOOP * LOOPS_BEFORE_MORPH;  // 540 frames
 static const int MORPH_DURATION = 180;  // 180 frames morph transition
 static const int EXPORT_INTERVAL = 1;  // Export every frame for PNG sequence
+static const double CAMERA_DISTANCE = 10.0;  // Fixed camera on the Z axis
 
 static int frameCounter = 0;
 static int globalFrameCounter = 0;  // For PNG export numbering
+static bool quiet = false;          // No per-frame console output
 
 //- Model namespace containing 2 3D models
+//- Models are point clouds of separate position and colour arrays (see
+//- c64_morph.h), allocated once at startup. The current model is morphed
+//- into the same memory every frame, whatever the number of vertices.
+//- Vertices are paired by a correspondence solver (c64_correspondence.h),
+//- not by index, so the models may differ in size and vertex order.
 namespace Models {
     
-    // Model structure
-    struct Vertex {
-        float x, y, z;
-        float r, g, b;  // Color
-    };
+    static const char* MATCH_CACHE = "morph_cache";
     
-    vector<Vertex> model1; // Torus (donut)
-    vector<Vertex> model2; // Star
+    PointCloud model1(shapes::MORPH_TORUS.count()); // Torus (donut)
+    PointCloud model2(shapes::MORPH_STAR.count());  // Star
     
-    vector<Vertex> currentModel;
+    // Both models reordered so that vertex i of one morphs into vertex i of the other
+    PointCloud morph1;
+    PointCloud morph2;
     
-    // Generate torus (donut) model with 64 vertices
-    void generateTorus() {
-        model1.clear();
-        const float majorRadius = 2.0f;
-        const float minorRadius = 0.8f;
-        const int majorSegments = 16;
-        const int minorSegments = 4;
-        
-        for (int i = 0; i < majorSegments; i++) {
-            float theta = 2.0f * M_PI * (float)i / (float)majorSegments;
-            float cosTheta = cos(theta);
-            float sinTheta = sin(theta);
-            
-            for (int j = 0; j < minorSegments; j++) {
-                float phi = 2.0f * M_PI * (float)j / (float)minorSegments;
-                float cosPhi = cos(phi);
-                float sinPhi = sin(phi);
-                
-                Vertex v;
-                v.x = (majorRadius + minorRadius * cosPhi) * cosTheta;
-                v.y = (majorRadius + minorRadius * cosPhi) * sinTheta;
-                v.z = minorRadius * sinPhi;
-                
-                // Pink/purple gradient
-                v.r = 0.8f + 0.2f * (float)i / majorSegments;
-                v.g = 0.3f + 0.3f * (float)j / minorSegments;
-                v.b = 0.8f;
-                
-                model1.push_back(v);
-            }
+    PointCloud currentModel;
+    
+    // Smoothstep morph progress for every morph frame
+    float morphCurve[MORPH_DURATION];
+    
+    // Torus (pink/purple) and star (rainbow), generated while compiling;
+    // the parameters are in c64_shapes.h, tools/shape-tables writes the
+    // same models for the C64
+    constexpr auto TORUS = shapes::generate<shapes::MORPH_TORUS.count()>(shapes::MORPH_TORUS);
+    constexpr auto STAR = shapes::generate<shapes::MORPH_STAR.count()>(shapes::MORPH_STAR);
+    
+    // Copy a generated table into a point cloud
+    template <int N>
+    void load(const shapes::Table<shapes::Vertex, N>& table, PointCloud* model) {
+        for (int i = 0; i < N; i++) {
+            const shapes::Vertex& v = table[i];
+            model->set(i, v.x, v.y, v.z, v.r, v.g, v.b);
         }
-        
-        cout << "Torus vertices: " << model1.size() << endl;
     }
     
-    // Generate icosahedron-like star model with 64 vertices
-    void generateStar() {
-        model2.clear();
-        const float innerRadius = 1.0f;
-        const float outerRadius = 3.5f;
-        const int numSpikes = 16;
-        const int pointsPerSpike = 4;
+    // Pair the vertices of both models with the least total travel
+    void matchModels() {
+        auto start = chrono::steady_clock::now();
+        Correspondence pairs;
+        bool cached = match_points_cached(model1, model2, MATCH_AUTO, MATCH_CACHE, &pairs);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
         
-        for (int i = 0; i < numSpikes; i++) {
-            // Horizontal angle
-            float theta = 2.0f * M_PI * (float)i / (float)numSpikes;
-            
-            // Vertical angle variation
-            float phi = M_PI / 4.0f * sin(2.0f * M_PI * (float)i / (float)numSpikes);
-            
-            for (int j = 0; j < pointsPerSpike; j++) {
-                float t = (float)j / (float)(pointsPerSpike - 1);
-                float r = innerRadius + (outerRadius - innerRadius) * t;
-                
-                Vertex v;
-                v.x = r * cos(theta) * cos(phi);
-                v.y = r * sin(theta) * cos(phi);
-                v.z = r * sin(phi);
-                
-                // Rainbow gradient
-                float hue = (float)i / numSpikes;
-                v.r = 0.5f + 0.5f * cos(hue * 2.0f * M_PI);
-                v.g = 0.5f + 0.5f * cos((hue + 0.33f) * 2.0f * M_PI);
-                v.b = 0.5f + 0.5f * cos((hue + 0.67f) * 2.0f * M_PI);
-                
-                model2.push_back(v);
-            }
-        }
+        pair_points(pairs, model1, model2, &morph1, &morph2);
+        currentModel.resize(pairs.size());
         
-        cout << "Star vertices: " << model2.size() << endl;
+        Correspondence byIndex;
+        for (int i = 0; i < pairs.size(); i++) {
+            byIndex.from.push_back(i * model1.size() / pairs.size());
+            byIndex.to.push_back(i * model2.size() / pairs.size());
+        }
+        cout << "Vertex pairs: " << pairs.size() << (cached ? " (cached, " : " (matched in ") << ms
+             << " ms), squared travel " << correspondence_cost(pairs, model1, model2)
+             << " instead of " << correspondence_cost(byIndex, model1, model2) << " by index" << endl;
     }
     
     // Initialize all models
     void generateAll() {
-        generateTorus();
-        generateStar();
-        
-        // Start with first model
-        currentModel = model1;
-    }
-    
-    // Linear interpolation between two vertices
-    Vertex lerp(const Vertex& a, const Vertex& b, float t) {
-        Vertex result;
-        result.x = a.x + (b.x - a.x) * t;
-        result.y = a.y + (b.y - a.y) * t;
-        result.z = a.z + (b.z - a.z) * t;
-        result.r = a.r + (b.r - a.r) * t;
-        result.g = a.g + (b.g - a.g) * t;
-        result.b = a.b + (b.b - a.b) * t;
-        return result;
+        load(TORUS, &model1);
+        load(STAR, &model2);
+        cout << "Torus vertices: " << model1.size() << endl;
+        cout << "Star vertices: " << model2.size() << endl;
+        matchModels();
+        smoothstep_table(MORPH_DURATION, morphCurve);
     }
     
-    // Update current model based on time (morphing logic)
-    void update(int frame) {
-        int totalFrames = 2 * FRAMES_PER_MODEL;  // 2 models total
-        frame = frame % totalFrames;
-        
+    // Models to interpolate between and morph progress for a frame
+    float morphState(int frame, const PointCloud** fromModel, const PointCloud** toModel) {
+        frame = frame % (2 * FRAMES_PER_MODEL);  // 2 models total
         int modelIndex = frame / FRAMES_PER_MODEL;
         int frameInModel = frame % FRAMES_PER_MODEL;
         
-        // Determine which models to interpolate between
-        const vector<Vertex>* fromModel;
-        const vector<Vertex>* toModel;
-        float morphProgress = 0.0f;
-        
         // Select models based on current time (only 2 models now)
         switch (modelIndex) {
-            case 0: fromModel = &model1; toModel = &model2; break;
-            case 1: fromModel = &model2; toModel = &model1; break;
-            default: fromModel = &model1; toModel = &model1; break;
+            case 0: *fromModel = &morph1; *toModel = &morph2; break;
+            case 1: *fromModel = &morph2; *toModel = &morph1; break;
+            default: *fromModel = &morph1; *toModel = &morph1; break;
         }
         
-        // Calculate morph progress during last 2 seconds of display
+        // Morph during the last MORPH_DURATION frames of each model
         if (frameInModel >= FRAMES_PER_MODEL - MORPH_DURATION) {
-            int morphFrame = frameInModel - (FRAMES_PER_MODEL - MORPH_DURATION);
-            morphProgress = (float)morphFrame / (float)MORPH_DURATION;
-            // Smooth interpolation using smoothstep
-            morphProgress = morphProgress * morphProgress * (3.0f - 2.0f * morphProgress);
+            return morphCurve[frameInModel - (FRAMES_PER_MODEL - MORPH_DURATION)];
         }
+        return 0.0f;
+    }
+    
+    // Update current model based on time (morphing logic)
+    void update(int frame) {
+        const PointCloud* fromModel;
+        const PointCloud* toModel;
+        float morphProgress = morphState(frame, &fromModel, &toModel);
         
-        // Interpolate vertices
-        currentModel.clear();
-        for (int i = 0; i < NUM_VERTICES; i++) {
-            Vertex v = lerp((*fromModel)[i], (*toModel)[i], morphProgress);
-            currentModel.push_back(v);
-        }
+        // Interpolate vertices in place
+        morph_points(*fromModel, *toModel, morphProgress, &currentModel);
         
         // Debug output every 60 frames (once per second)
-        if (frame % 60 == 0) {
+        frame = frame % (2 * FRAMES_PER_MODEL);
+        if (frame % 60 == 0 && !quiet) {
+            int frameInModel = frame % FRAMES_PER_MODEL;
             int loopNum = (frameInModel / FRAMES_PER_LOOP) + 1;
             int frameInLoop = frameInModel % FRAMES_PER_LOOP;
             cout << "Frame: " << frame 
-                 << " | Model: " << (modelIndex + 1) 
+                 << " | Model: " << (frame / FRAMES_PER_MODEL + 1) 
                  << " | Loop: " << loopNum << "/2"
                  << " | Frame in loop: " << frameInLoop
                  << " | Morph: " << (int)(morphProgress * 100) << "%" << endl;
@@ -182,151 +156,393 @@ namespace Models {
     
     // Draw current model using GL_POINTS
     void draw() {
+        const float* x = currentModel.x();
+        const float* y = currentModel.y();
+        const float* z = currentModel.z();
+        const float* r = currentModel.channel(PointCloud::RED);
+        const float* g = currentModel.channel(PointCloud::GREEN);
+        const float* b = currentModel.channel(PointCloud::BLUE);
+        
         glPointSize(5.0f);
         glBegin(GL_POINTS);
-        for (size_t i = 0; i < currentModel.size(); i++) {
-            const Vertex& v = currentModel[i];
-            glColor3f(v.r, v.g, v.b);
-            glVertex3f(v.x, v.y, v.z);
+        for (int i = 0; i < currentModel.size(); i++) {
+            glColor3f(r[i], g[i], b[i]);
+            glVertex3f(x[i], y[i], z[i]);
         }
         glEnd();
     }
 }
 
-// Save current frame as PNG
-void saveFrameAsPNG() {
-    int width = 800;
-    int height = 600;
+//- Frame export: a PPM image and a coordinate file for every frame
+//- Pixels are read back through a ring of pixel buffer objects, so a
+//- frame is only copied out once the next frames are being drawn.
+//- In batch mode the files are written by a separate thread. Frames
+//- travel to it through a lock-free ring and come back through a second
+//- one, so the buffers are allocated once and rendering only waits when
+//- every buffer is still queued for writing.
+namespace Export {
+    
+    struct Frame {
+        int number;
+        vector<int16_t> screenX;        // one per vertex of the current model
+        vector<int16_t> screenY;
+        vector<unsigned char> image;    // PPM header and rows, top row first
+        size_t headerSize;
+        bool imageRead;                 // false if the readback lost the pixels
+        vector<char> text;              // coordinate file
+    };
     
-    // Allocate memory for pixel data
-    unsigned char* pixels = new unsigned char[width * height * 3];
+    static const int POOL_SIZE = 8;
+    static const int READBACK_DEPTH = 3;
+    
+    bool async = false;                 // write from a separate thread (headless runs)
+    vector<Frame> pool;
+    FrameReadback readback;
+    deque<Frame*> reading;              // frames queued in the readback ring
+    RingBuffer<Frame*> writeQueue(POOL_SIZE);
+    RingBuffer<Frame*> freeFrames(POOL_SIZE);
+    thread writer;
+    atomic<bool> rendering(false);
+    atomic<bool> failed(false);         // a file could not be written
+    atomic<int> framesWritten(0);
+    atomic<int> framesLost(0);          // frames the readback could not deliver
+    
+    // Back off while waiting on the other thread: spin briefly, then sleep
+    void wait(int attempt) {
+        if (attempt < 64) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }
+    
+    bool writeFile(const char* filename, const void* data, size_t size) {
+        FILE* f = fopen(filename, "wb");
+        if (!f) {
+            return false;
+        }
+        bool ok = fwrite(data, 1, size, f) == size;
+        return fclose(f) == 0 && ok;
+    }
     
-    // Read pixels from framebuffer
-    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    void write(Frame& frame) {
+        // Coordinates in the format vertex[i]:x,y
+        size_t length = 0;
+        for (size_t i = 0; i < frame.screenX.size(); i++) {
+            length += snprintf(&frame.text[length], frame.text.size() - length, "vertex[%d]:%d,%d\n",
+                               (int)i, frame.screenX[i], frame.screenY[i]);
+        }
+        
+        // A frame the readback lost gets no image rather than a black one
+        char filename[64];
+        bool ok = true;
+        if (frame.imageRead) {
+            snprintf(filename, sizeof(filename), "frame_%06d.ppm", frame.number);
+            ok = writeFile(filename, &frame.image[0], frame.image.size());
+        } else if (framesLost++ == 0) {
+            cerr << "Could not read back frame " << frame.number << ", skipping its image" << endl;
+        }
+        snprintf(filename, sizeof(filename), "coordinates_%06d.txt", frame.number);
+        ok = writeFile(filename, &frame.text[0], length) && ok;
+        if (!ok && !failed.exchange(true)) {
+            cerr << "Could not write frame " << frame.number << endl;
+        }
+        framesWritten++;
+        
+        if (!quiet && frame.imageRead) {
+            cout << "Saved frame_" << setfill('0') << setw(6) << frame.number << ".ppm (frame "
+                 << setfill(' ') << frame.number << ")" << endl;
+        }
+    }
     
-    // Create filename
-    stringstream ss;
-    ss << "frame_" << setfill('0') << setw(6) << globalFrameCounter << ".ppm";
-    string filename = ss.str();
+    // Writer thread: write frames until rendering has finished and the queue is drained
+    void writerLoop() {
+        int attempt = 0;
+        for (;;) {
+            Frame* frame = NULL;
+            if (writeQueue.try_pop(frame)) {
+                write(*frame);
+                freeFrames.try_push(frame);
+                attempt = 0;
+                continue;
+            }
+            // Frames are queued before rendering signs off, so once it has
+            // an empty queue stays empty
+            if (!rendering) {
+                if (!writeQueue.try_pop(frame)) {
+                    break;
+                }
+                write(*frame);
+                continue;
+            }
+            wait(attempt++);
+        }
+    }
     
-    // Save as PPM (simple format that can be converted to PNG)
-    ofstream file(filename, ios::binary);
-    file << "P6\n" << width << " " << height << "\n255\n";
+    // Set up the buffers (needs the GL context) and start the writer
+    void init() {
+        pool.resize(POOL_SIZE);
+        for (int i = 0; i < POOL_SIZE; i++) {
+            // The PPM header stays in front of the pixels read back
+            char header[32];
+            Frame& frame = pool[i];
+            frame.headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+            frame.image.resize(frame.headerSize + WIDTH * HEIGHT * 3);
+            memcpy(&frame.image[0], header, frame.headerSize);
+            frame.screenX.resize(Models::currentModel.size());
+            frame.screenY.resize(Models::currentModel.size());
+            frame.text.resize(Models::currentModel.size() * 32);
+            freeFrames.try_push(&frame);
+        }
+        readback.init(0, 0, WIDTH, HEIGHT, READBACK_DEPTH);
+        
+        if (async) {
+            rendering = true;
+            writer = thread(writerLoop);
+        }
+    }
     
-    // Flip vertically (OpenGL's origin is bottom-left)
-    for (int y = height - 1; y >= 0; y--) {
-        file.write((char*)(pixels + y * width * 3), width * 3);
+    // Buffer for the next frame; blocks while all buffers wait for the writer
+    Frame* acquire() {
+        Frame* frame = NULL;
+        for (int attempt = 0; !freeFrames.try_pop(frame); attempt++) {
+            wait(attempt);
+        }
+        return frame;
     }
     
-    file.close();
-    delete[] pixels;
+    void submit(Frame* frame) {
+        if (!async) {
+            write(*frame);
+            freeFrames.try_push(frame);
+            return;
+        }
+        for (int attempt = 0; !writeQueue.try_push(frame); attempt++) {
+            wait(attempt);
+        }
+    }
     
-    cout << "Saved " << filename << " (frame " << globalFrameCounter << ")" << endl;
-}
-
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Copy the oldest frame out of the readback ring and hand it on
+    void collect() {
+        Frame* frame = reading.front();
+        reading.pop_front();
+        frame->imageRead = readback.collect(&frame->image[frame->headerSize]);
+        submit(frame);
+    }
     
-    glPushMatrix();
+    // Queue the read of the frame just drawn
+    void capture(Frame* frame) {
+        if (readback.full()) {
+            collect();
+        }
+        readback.begin(frame->number);
+        reading.push_back(frame);
+    }
     
-    // Calculate rotation angle based on frame number within loop
-    // This makes the rotation independent from morphing
+    // Write the frames still in flight and stop the writer thread
+    void finish() {
+        while (readback.pending()) {
+            collect();
+        }
+        if (async) {
+            rendering = false;
+            writer.join();
+            async = false;
+        }
+    }
+}
+
+// Calculate rotation angle based on frame number within loop
+// This makes the rotation independent from morphing
+float rotationAngle(int frame) {
     int totalFrames = 2 * FRAMES_PER_MODEL;  // 2 models total
-    int currentFrame = frameCounter % totalFrames;
+    int currentFrame = frame % totalFrames;
     int frameInModel = currentFrame % FRAMES_PER_MODEL;
     
     // Determine if we're in morph phase or loop phase
     bool inMorphPhase = frameInModel >= FRAMES_PER_MODEL - MORPH_DURATION;
     
-    float rotationAngle;
     if (inMorphPhase) {
         // During morph, continue rotation from last loop
         int morphFrame = frameInModel - (FRAMES_PER_MODEL - MORPH_DURATION);
-        rotationAngle = 360.0f + (360.0f * morphFrame / (float)MORPH_DURATION);
-    } else {
-        // During loop phase, rotate based on frame within loop
-        int loopFrame = frameInModel % FRAMES_PER_LOOP;
-        rotationAngle = 360.0f * loopFrame / (float)FRAMES_PER_LOOP;
+        return 360.0f + (360.0f * morphFrame / (float)MORPH_DURATION);
+    }
+    // During loop phase, rotate based on frame within loop
+    int loopFrame = frameInModel % FRAMES_PER_LOOP;
+    return 360.0f * loopFrame / (float)FRAMES_PER_LOOP;
+}
+
+//- Keyframe table: the whole cycle projected once for the C64 screen
+//- Same models, morph and rotation as display(), but the matrices are built
+//- here instead of by OpenGL, so no window or GL context is needed.
+namespace Table {
+    static const int SCREEN_WIDTH = 320;
+    static const int SCREEN_HEIGHT = 200;
+    
+    // m = m * rotation about a unit axis, like glRotatef()
+    void rotate(double* m, double degrees, double ax, double ay, double az) {
+        double radians = degrees * M_PI / 180.0;
+        double c = cos(radians), s = sin(radians), d = 1.0 - c;
+        double r[9] = {  // column-major 3x3
+            ax * ax * d + c,      ay * ax * d + az * s, az * ax * d - ay * s,
+            ax * ay * d - az * s, ay * ay * d + c,      az * ay * d + ax * s,
+            ax * az * d + ay * s, ay * az * d - ax * s, az * az * d + c
+        };
+        double result[12];
+        for (int column = 0; column < 3; column++) {
+            for (int row = 0; row < 4; row++) {
+                result[column * 4 + row] = m[row] * r[column * 3] + m[4 + row] * r[column * 3 + 1]
+                                         + m[8 + row] * r[column * 3 + 2];
+            }
+        }
+        memcpy(m, result, sizeof(result));
+    }
+    
+    // Perspective matrix like gluPerspective()
+    void perspective(double fovy, double aspect, double zNear, double zFar, double* m) {
+        double f = 1.0 / tan(fovy * M_PI / 360.0);
+        memset(m, 0, 16 * sizeof(double));
+        m[0] = f / aspect;
+        m[5] = f;
+        m[10] = (zFar + zNear) / (zNear - zFar);
+        m[11] = -1.0;
+        m[14] = 2.0 * zFar * zNear / (zNear - zFar);
+    }
+    
+    void build(MorphTable* table) {
+        const int frames = 2 * FRAMES_PER_MODEL;
+        const int viewport[4] = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+        double projectionMatrix[16];
+        perspective(60.0, (double)SCREEN_WIDTH / SCREEN_HEIGHT, 0.5, 50.0, projectionMatrix);
+        
+        PointCloud cloud(Models::currentModel.size());
+        table->resize(frames, cloud.size());
+        for (int frame = 0; frame < frames; frame++) {
+            const PointCloud* fromModel;
+            const PointCloud* toModel;
+            float morphProgress = Models::morphState(frame, &fromModel, &toModel);
+            morph_points(*fromModel, *toModel, morphProgress, &cloud);
+            
+            // Fixed camera, then the rotations of display()
+            double modelview[16] = {1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, -CAMERA_DISTANCE, 1};
+            float angle = rotationAngle(frame);
+            rotate(modelview, angle, 0.0, 1.0, 0.0);
+            rotate(modelview, angle * 2.0f, 1.0, 0.0, 0.0);
+            rotate(modelview, angle, 0.0, 0.0, 1.0);
+            
+            Projection projection;
+            projection_from_matrices(modelview, projectionMatrix, viewport, &projection);
+            table->record(frame, projection, cloud, 0, 0);
+        }
+    }
+    
+    // Precompute one full cycle and write it, without opening a window
+    int write(const string& path) {
+        Models::generateAll();
+        
+        auto start = chrono::steady_clock::now();
+        MorphTable table;
+        build(&table);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        
+        if (!table.write(path)) {
+            cerr << "Could not write " << path << endl;
+            return 1;
+        }
+        cout << "Wrote " << path << ": " << table.frames() << " frames of " << table.points()
+             << " x/y coordinates for a " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << " screen ("
+             << table.bytes() << " bytes, " << ms << " ms)" << endl;
+        return 0;
+    }
+    
+    // Precompute one full cycle and write it as C64 data tables (c64_precalc.h)
+    int writePrecalc(const PrecalcOptions& options) {
+        Models::generateAll();
+        
+        auto start = chrono::steady_clock::now();
+        MorphTable table;
+        build(&table);
+        PrecalcTable precalc;
+        precalc.resize(table.frames(), table.points());
+        for (int frame = 0; frame < table.frames(); frame++) {
+            precalc.record(frame, table.screen_x(frame), table.screen_y(frame), NULL);
+        }
+        if (!write_precalc_report(precalc, string("morph_") + raster_name(options.raster), "morph", options)) {
+            return 1;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Built and written in " << ms << " ms" << endl;
+        return 0;
     }
+}
+
+void display() {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    
+    glPushMatrix();
+    
+    float angle = rotationAngle(frameCounter);
     
     // Multi-axis rotation - all axes complete full rotations in 180 frames for seamless looping
     // Y-axis: 1 full rotation (360°) in 180 frames
-    glRotatef(rotationAngle, 0.0, 1.0, 0.0);
+    glRotatef(angle, 0.0, 1.0, 0.0);
     // X-axis: 2 full rotations (720°) in 180 frames for more dynamic movement
-    glRotatef(rotationAngle * 2.0f, 1.0, 0.0, 0.0);
+    glRotatef(angle * 2.0f, 1.0, 0.0, 0.0);
     // Z-axis: 1 full rotation (360°) in 180 frames
-    glRotatef(rotationAngle, 0.0, 0.0, 1.0);
+    glRotatef(angle, 0.0, 0.0, 1.0);
     
     // Update and draw current model
     Models::update(frameCounter);
     Models::draw();
     
-    // Export coordinates every frame using gluProject
+    // Export integer screen coordinates (C64 style, row 0 at the top)
+    Export::Frame* exportFrame = NULL;
     if (frameCounter % EXPORT_INTERVAL == 0) {
-        // Get the current matrices and viewport
-        GLdouble modelview[16];
-        GLdouble projection[16];
-        GLint viewport[4];
-        
-        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-        glGetDoublev(GL_PROJECTION_MATRIX, projection);
-        glGetIntegerv(GL_VIEWPORT, viewport);
+        exportFrame = Export::acquire();
+        exportFrame->number = globalFrameCounter;
         
-        GLdouble projectedCoords[NUM_VERTICES][3];
+        Projection projection;
+        projection_from_gl(&projection);
+        const PointCloud& model = Models::currentModel;
+        project_points_c64(projection, model.x(), model.y(), model.z(), model.size(),
+                           0, 0, &exportFrame->screenX[0], &exportFrame->screenY[0], NULL);
         
-        // Create coordinate export filename
-        stringstream coordFilename;
-        coordFilename << "coordinates_" << setfill('0') << setw(6) << globalFrameCounter << ".txt";
-        ofstream coordFile(coordFilename.str());
-        
-        // Project all vertices to window coordinates
-        for (int i = 0; i < NUM_VERTICES; i++) {
-            gluProject(
-                (GLdouble)Models::currentModel[i].x,
-                (GLdouble)Models::currentModel[i].y,
-                (GLdouble)Models::currentModel[i].z,
-                modelview,
-                projection,
-                viewport,
-                &projectedCoords[i][0],
-                &projectedCoords[i][1],
-                &projectedCoords[i][2]
-            );
-            cout << "Vertex " << i << " -> Window coords: (" 
-                 << projectedCoords[i][0] << ", " 
-                 << projectedCoords[i][1] << ")" << endl;
-            
-            // Write to file in requested format: vertex[i]:x,y
-            coordFile << "vertex[" << i << "]:" 
-                     << projectedCoords[i][0] << "," 
-                     << projectedCoords[i][1] << endl;
+        if (!quiet) {
+            for (int i = 0; i < model.size(); i++) {
+                cout << "Vertex " << i << " -> Screen coords: (" 
+                     << exportFrame->screenX[i] << ", " 
+                     << exportFrame->screenY[i] << ")" << endl;
+            }
         }
-        
-        coordFile.close();
     }
     
     glPopMatrix();
     
-    glutSwapBuffers();
+    present_frame();
     
-    // Save frame as PNG for video export
-    saveFrameAsPNG();
+    // Save frame and coordinates for video export
+    if (exportFrame) {
+        Export::capture(exportFrame);
+    }
     
     frameCounter++;
     globalFrameCounter++;
 }
 
-void timer(int v) {
+// One animation step: what the GLUT timer does between two frames
+void advance() {
     glLoadIdentity();
     
     // Fixed camera position (no orbiting/zooming)
-    float camDist = 10.0f;
     gluLookAt(
-        0.0, 0.0, camDist,  // Camera position - fixed on Z axis
-        0.0, 0.0, 0.0,      // Look at origin
-        0, 1, 0             // Up vector
+        0.0, 0.0, CAMERA_DISTANCE,  // Camera position - fixed on Z axis
+        0.0, 0.0, 0.0,              // Look at origin
+        0, 1, 0                     // Up vector
     );
-    
+}
+
+void timer(int v) {
+    advance();
     glutPostRedisplay();
     glutTimerFunc(1000/FPS, timer, v);
 }
@@ -353,10 +569,12 @@ void init() {
     
     // Generate all models
     Models::generateAll();
+    Export::init();
     
     cout << "\n=== 3D Morphing Models Demo ===" << endl;
     cout << "FPS: " << FPS << endl;
-    cout << "Total vertices per model: " << NUM_VERTICES << endl;
+    cout << "Vertices: " << Models::model1.size() << " (torus), " << Models::model2.size()
+         << " (star), " << Models::currentModel.size() << " drawn while morphing" << endl;
     cout << "Frames per loop: " << FRAMES_PER_LOOP << " (" << (FRAMES_PER_LOOP / FPS) << " seconds)" << endl;
     cout << "Loops before morph: " << LOOPS_BEFORE_MORPH << endl;
     cout << "Display time per model: " << (FRAMES_PER_MODEL / FPS) << " seconds" << endl;
@@ -373,10 +591,77 @@ void init() {
     cout << "================================\n" << endl;
 }
 
+// Headless runs: wait for the writer and report; the export fails if a file
+// could not be written or a frame image is missing
+bool finishExport() {
+    Export::finish();
+    cout << "Exported " << Export::framesWritten << " frames (frame_*.ppm, coordinates_*.txt)" << endl;
+    if (Export::framesLost > 0) {
+        cerr << Export::framesLost << " frames could not be read back and have no frame_*.ppm" << endl;
+    }
+    return !Export::failed && Export::framesLost == 0;
+}
+
 int main(int argc, char** argv) {
+    // --headless FRAMES renders without a window, see c64_headless.h
+    HeadlessOptions headless;
+    if (!parse_headless_args(&argc, argv, &headless)) {
+        return 1;
+    }
+    
+    // --precalc sprite|char writes the cycle as C64 data tables and exits
+    PrecalcOptions precalc;
+    if (!parse_precalc_args(&argc, argv, &precalc)) {
+        return 1;
+    }
+    
+    // --batch renders one full cycle headless, --quiet drops per-frame output,
+    // --table writes the precomputed C64 coordinate table and exits
+    bool batch = false;
+    bool table = false;
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--table") {
+            table = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            cerr << "Usage: " << argv[0] << " [--batch] [--quiet] [--table] [--headless FRAMES]"
+                 << " [--precalc sprite|char [--delta | --dedup] [--kickass]]" << endl;
+            return 1;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    argv[argc] = NULL;
+    
+    if (table) {
+        return Table::write("morph_table.bin");
+    }
+    if (precalc.enabled) {
+        return Table::writePrecalc(precalc);
+    }
+    
+    if (batch) {
+        quiet = true;
+        if (headless.frames == 0) {
+            headless.frames = 2 * FRAMES_PER_MODEL;
+        }
+    }
+
+    if (headless.frames > 0) {
+        Export::async = true;
+        HeadlessScene scene = {reshape, init, display, advance, finishExport};
+        return run_headless(headless, WIDTH, HEIGHT, scene);
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
-    glutInitWindowSize(800, 600);
+    glutInitWindowSize(WIDTH, HEIGHT);
     glutCreateWindow("3D Morphing Models - GL_POINTS Demo");
     glutReshapeFunc(reshape);
     glutTimerFunc(100, timer, 0);
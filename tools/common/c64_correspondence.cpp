@@ -0,0 +1,598 @@
+/*
+ * Vertex correspondence for morphing between point models
+ * See c64_correspondence.h.
+ */
+
+#include "c64_correspondence.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <sys/stat.h>
+
+// Leaf blocks of the approximate mode are matched exactly
+static const int LEAF_SIZE = 48;
+// Passes of block reassignment after the initial approximate match: at most
+// REFINE_PASSES, ending early once a round over every kind of cut (one pass
+// per side and cut position) gains less than REFINE_MIN_GAIN
+static const int REFINE_PASSES = 24;
+static const double REFINE_MIN_GAIN = 0.01;
+// Refinement cuts split at 4/8, 3/8 or 5/8 of the pairs, so blocks of
+// different passes overlap and pairs can move across any block border
+static const int REFINE_CUTS = 3;
+static const int REFINE_CUT_EIGHTHS[REFINE_CUTS] = {4, 3, 5};
+
+/**
+ * Positions of one model
+ */
+struct Points {
+    const float* x;
+    const float* y;
+    const float* z;
+
+    explicit Points(const PointCloud& cloud) : x(cloud.x()), y(cloud.y()), z(cloud.z()) {
+    }
+
+    const float* axis(int a) const {
+        return a == 0 ? x : (a == 1 ? y : z);
+    }
+};
+
+static float distance2(const Points& a, int i, const Points& b, int j) {
+    float dx = a.x[i] - b.x[j];
+    float dy = a.y[i] - b.y[j];
+    float dz = a.z[i] - b.z[j];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/**
+ * Minimal cost assignment of an n x n cost matrix (Hungarian algorithm with
+ * potentials, shortest augmenting paths)
+ * cost(row, column) is evaluated on the fly; column_row[column] receives
+ * the row assigned to each column.
+ */
+template <class Cost>
+static void hungarian(int n, const Cost& cost, std::vector<int>* column_row) {
+    column_row->resize(n);
+    if (n <= 0) {
+        return;
+    }
+    const double infinity = std::numeric_limits<double>::infinity();
+    // 1-based, index 0 is the virtual start column
+    std::vector<double> u(n + 1, 0.0), v(n + 1, 0.0), min_slack(n + 1);
+    std::vector<int> row_of(n + 1, 0), way(n + 1, 0);
+    std::vector<char> used(n + 1);
+
+    for (int row = 1; row <= n; row++) {
+        row_of[0] = row;
+        int column = 0;
+        std::fill(min_slack.begin(), min_slack.end(), infinity);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[column] = 1;
+            int current_row = row_of[column];
+            double delta = infinity;
+            int next = 0;
+            for (int j = 1; j <= n; j++) {
+                if (used[j]) {
+                    continue;
+                }
+                double slack = cost(current_row - 1, j - 1) - u[current_row] - v[j];
+                if (slack < min_slack[j]) {
+                    min_slack[j] = slack;
+                    way[j] = column;
+                }
+                if (min_slack[j] < delta) {
+                    delta = min_slack[j];
+                    next = j;
+                }
+            }
+            for (int j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[row_of[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    min_slack[j] -= delta;
+                }
+            }
+            column = next;
+        } while (row_of[column] != 0);
+        // Flip the augmenting path
+        do {
+            int previous = way[column];
+            row_of[column] = row_of[previous];
+            column = previous;
+        } while (column != 0);
+    }
+
+    for (int j = 1; j <= n; j++) {
+        (*column_row)[j - 1] = row_of[j] - 1;
+    }
+}
+
+/**
+ * Cost of matching a block of the larger model (rows) to a block of the
+ * smaller one: the first columns are the points of the smaller block that
+ * must be covered, the remaining ones stand for "any candidate", so rows
+ * assigned there take their nearest candidate
+ */
+struct BlockCost {
+    const Points& large;
+    const int* large_index;
+    const Points& small;
+    const int* small_index;
+    int required;
+    const float* nearest_distance;
+
+    double operator()(int row, int column) const {
+        if (column < required) {
+            return distance2(large, large_index[row], small, small_index[column]);
+        }
+        return nearest_distance[row];
+    }
+};
+
+/**
+ * Optimal pairs of a block of the larger model with points of the smaller
+ * one: every row gets one partner among the candidates, and each of the
+ * first required candidates at least one (large_count >= required)
+ */
+static void solve_block(const Points& large, const int* large_index, int large_count,
+                        const Points& small, const int* small_index, int required, int candidates,
+                        std::vector<std::pair<int, int> >* pairs) {
+    std::vector<float> nearest_distance(large_count, 0.0f);
+    std::vector<int> nearest(large_count, 0);
+    if (large_count > required) {
+        for (int i = 0; i < large_count; i++) {
+            float best = distance2(large, large_index[i], small, small_index[0]);
+            for (int j = 1; j < candidates; j++) {
+                float d = distance2(large, large_index[i], small, small_index[j]);
+                if (d < best) {
+                    best = d;
+                    nearest[i] = j;
+                }
+            }
+            nearest_distance[i] = best;
+        }
+    }
+
+    BlockCost cost = {large, large_index, small, small_index, required, &nearest_distance[0]};
+    std::vector<int> column_row;
+    hungarian(large_count, cost, &column_row);
+    pairs->resize(pairs->size() + large_count);
+    std::pair<int, int>* out = &(*pairs)[pairs->size() - large_count];
+    for (int column = 0; column < large_count; column++) {
+        int row = column_row[column];
+        int partner = column < required ? column : nearest[row];
+        out[row] = std::make_pair(large_index[row], small_index[partner]);
+    }
+}
+
+/**
+ * Optimal pairs of two blocks, large_count >= small_count: every point of
+ * the large block gets one partner and every point of the small one at
+ * least one
+ */
+static void match_block(const Points& large, const int* large_index, int large_count,
+                        const Points& small, const int* small_index, int small_count,
+                        std::vector<std::pair<int, int> >* pairs) {
+    solve_block(large, large_index, large_count, small, small_index, small_count, small_count, pairs);
+}
+
+/**
+ * Longest axis of the common bounding box of two index lists
+ */
+static int longest_axis(const Points& a, const int* a_index, int a_count,
+                        const Points& b, const int* b_index, int b_count) {
+    float extent[3];
+    for (int axis = 0; axis < 3; axis++) {
+        const float* pa = a.axis(axis);
+        const float* pb = b.axis(axis);
+        float low = pa[a_index[0]], high = low;
+        for (int i = 1; i < a_count; i++) {
+            low = std::min(low, pa[a_index[i]]);
+            high = std::max(high, pa[a_index[i]]);
+        }
+        for (int i = 0; i < b_count; i++) {
+            low = std::min(low, pb[b_index[i]]);
+            high = std::max(high, pb[b_index[i]]);
+        }
+        extent[axis] = high - low;
+    }
+    int axis = 0;
+    for (int i = 1; i < 3; i++) {
+        if (extent[i] > extent[axis]) {
+            axis = i;
+        }
+    }
+    return axis;
+}
+
+/**
+ * Split both index lists in the same proportion along the longest axis of
+ * their common bounding box until the blocks are small enough to match
+ * exactly (large_count >= small_count >= 1)
+ */
+static void bisect(const Points& large, int* large_index, int large_count,
+                   const Points& small, int* small_index, int small_count,
+                   std::vector<std::pair<int, int> >* pairs) {
+    if (small_count == 1) {
+        for (int i = 0; i < large_count; i++) {
+            pairs->push_back(std::make_pair(large_index[i], small_index[0]));
+        }
+        return;
+    }
+    if (large_count <= LEAF_SIZE) {
+        match_block(large, large_index, large_count, small, small_index, small_count, pairs);
+        return;
+    }
+
+    int axis = longest_axis(large, large_index, large_count, small, small_index, small_count);
+    int large_half = large_count / 2;
+    int small_half = static_cast<int>((static_cast<long long>(small_count) * large_half + large_count / 2)
+                                      / large_count);
+    small_half = std::max(1, std::min(small_count - 1, small_half));
+
+    const float* pl = large.axis(axis);
+    const float* ps = small.axis(axis);
+    std::nth_element(large_index, large_index + large_half, large_index + large_count,
+                     [pl](int i, int j) { return pl[i] < pl[j]; });
+    std::nth_element(small_index, small_index + small_half, small_index + small_count,
+                     [ps](int i, int j) { return ps[i] < ps[j]; });
+    bisect(large, large_index, large_half, small, small_index, small_half, pairs);
+    bisect(large, large_index + large_half, large_count - large_half,
+           small, small_index + small_half, small_count - small_half, pairs);
+}
+
+/**
+ * Sum of the squared distances of the pairs a_index[k] - b_index[k]
+ */
+static double total_distance2(const Points& a, const int* a_index, const Points& b, const int* b_index, int n) {
+    double total = 0.0;
+    for (int i = 0; i < n; i++) {
+        total += distance2(a, a_index[i], b, b_index[i]);
+    }
+    return total;
+}
+
+/**
+ * Split the pairs in order (n of them) into blocks of at most LEAF_SIZE
+ * pairs that lie close together on one side, points[point_of[pair]];
+ * every split puts REFINE_CUT_EIGHTHS[cut] / 8 of the pairs below it
+ */
+static void partition(const Points& points, const int* point_of, int* order, int n, int cut,
+                      std::vector<int>* block_ends, int first) {
+    if (n <= LEAF_SIZE) {
+        block_ends->push_back(first + n);
+        return;
+    }
+    float low[3], high[3];
+    for (int axis = 0; axis < 3; axis++) {
+        const float* p = points.axis(axis);
+        low[axis] = high[axis] = p[point_of[order[0]]];
+        for (int i = 1; i < n; i++) {
+            low[axis] = std::min(low[axis], p[point_of[order[i]]]);
+            high[axis] = std::max(high[axis], p[point_of[order[i]]]);
+        }
+    }
+    int axis = 0;
+    for (int i = 1; i < 3; i++) {
+        if (high[i] - low[i] > high[axis] - low[axis]) {
+            axis = i;
+        }
+    }
+    int half = n * REFINE_CUT_EIGHTHS[cut] / 8;
+    const float* p = points.axis(axis);
+    std::nth_element(order, order + half, order + n,
+                     [p, point_of](int i, int j) { return p[point_of[i]] < p[point_of[j]]; });
+    partition(points, point_of, order, half, cut, block_ends, first);
+    partition(points, point_of, order + half, n - half, cut, block_ends, first + half);
+}
+
+/**
+ * Improve the pairs a_index[k] - b_index[k]: cut them into blocks that are
+ * close together on one side and solve each block again with solve_block().
+ * Points of b that have a partner outside the block need not be covered in
+ * it, so split points can also move. Alternating the side and the cut
+ * position changes the blocks from pass to pass, so improvements spread. No
+ * pass makes the total worse.
+ */
+static void refine(const Points& a, int* a_index, const Points& b, int* b_index, int n, int b_count) {
+    std::vector<int> order(n), block_ends, rows, targets, distinct;
+    std::vector<int> coverage(b_count, 0), in_block(b_count, 0);
+    std::vector<std::pair<int, int> > block_pairs;
+    for (int i = 0; i < n; i++) {
+        coverage[b_index[i]]++;
+    }
+
+    const int round = 2 * REFINE_CUTS;
+    double round_start = total_distance2(a, a_index, b, b_index, n);
+    for (int pass = 0; pass < REFINE_PASSES; pass++) {
+        if (pass > 0 && pass % round == 0) {
+            double total = total_distance2(a, a_index, b, b_index, n);
+            if (total >= round_start * (1.0 - REFINE_MIN_GAIN)) {
+                break;
+            }
+            round_start = total;
+        }
+        bool by_a = pass % 2 == 0;
+        for (int i = 0; i < n; i++) {
+            order[i] = i;
+        }
+        block_ends.clear();
+        partition(by_a ? a : b, by_a ? a_index : b_index, &order[0], n, pass / 2 % REFINE_CUTS, &block_ends, 0);
+
+        int first = 0;
+        for (size_t block = 0; block < block_ends.size(); block++) {
+            int size = block_ends[block] - first;
+            const int* pairs = &order[first];
+            first = block_ends[block];
+
+            // Required targets first, then the ones also covered elsewhere
+            rows.clear();
+            targets.clear();
+            distinct.clear();
+            for (int i = 0; i < size; i++) {
+                int target = b_index[pairs[i]];
+                rows.push_back(a_index[pairs[i]]);
+                if (in_block[target]++ == 0) {
+                    distinct.push_back(target);
+                }
+            }
+            for (size_t i = 0; i < distinct.size(); i++) {
+                if (in_block[distinct[i]] == coverage[distinct[i]]) {
+                    targets.push_back(distinct[i]);
+                }
+            }
+            int required = static_cast<int>(targets.size());
+            for (size_t i = 0; i < distinct.size(); i++) {
+                if (in_block[distinct[i]] != coverage[distinct[i]]) {
+                    targets.push_back(distinct[i]);
+                }
+                coverage[distinct[i]] -= in_block[distinct[i]];
+                in_block[distinct[i]] = 0;
+            }
+
+            // Every row may take any target of the block, but only the
+            // required ones must keep a partner
+            block_pairs.clear();
+            solve_block(a, &rows[0], size, b, &targets[0], required, static_cast<int>(targets.size()),
+                        &block_pairs);
+            for (int i = 0; i < size; i++) {
+                a_index[pairs[i]] = block_pairs[i].first;
+                b_index[pairs[i]] = block_pairs[i].second;
+                coverage[block_pairs[i].second]++;
+            }
+        }
+    }
+}
+
+static void match_approximate(const Points& large, int large_count, const Points& small, int small_count,
+                              std::vector<std::pair<int, int> >* pairs) {
+    std::vector<int> large_index(large_count), small_index(small_count);
+    for (int i = 0; i < large_count; i++) {
+        large_index[i] = i;
+    }
+    for (int i = 0; i < small_count; i++) {
+        small_index[i] = i;
+    }
+    std::vector<std::pair<int, int> > initial;
+    initial.reserve(large_count);
+    bisect(large, &large_index[0], large_count, small, &small_index[0], small_count, &initial);
+
+    std::vector<int> partner(large_count);
+    for (int i = 0; i < large_count; i++) {
+        large_index[i] = initial[i].first;
+        partner[i] = initial[i].second;
+    }
+    refine(large, &large_index[0], small, &partner[0], large_count, small_count);
+    for (int i = 0; i < large_count; i++) {
+        pairs->push_back(std::make_pair(large_index[i], partner[i]));
+    }
+}
+
+static MatchMode resolve(MatchMode mode, const PointCloud& from, const PointCloud& to) {
+    if (mode != MATCH_AUTO) {
+        return mode;
+    }
+    return std::max(from.size(), to.size()) <= MATCH_EXACT_LIMIT ? MATCH_EXACT : MATCH_APPROXIMATE;
+}
+
+void match_points(const PointCloud& from, const PointCloud& to, MatchMode mode, Correspondence* result) {
+    result->from.clear();
+    result->to.clear();
+    if (from.size() == 0 || to.size() == 0) {
+        return;
+    }
+
+    // Work with the larger model as the first one
+    bool swapped = from.size() < to.size();
+    const PointCloud& large = swapped ? to : from;
+    const PointCloud& small = swapped ? from : to;
+    Points large_points(large), small_points(small);
+
+    std::vector<std::pair<int, int> > pairs;
+    pairs.reserve(large.size());
+    if (resolve(mode, from, to) == MATCH_EXACT) {
+        std::vector<int> large_index(large.size()), small_index(small.size());
+        for (int i = 0; i < large.size(); i++) {
+            large_index[i] = i;
+        }
+        for (int i = 0; i < small.size(); i++) {
+            small_index[i] = i;
+        }
+        match_block(large_points, &large_index[0], large.size(), small_points, &small_index[0], small.size(),
+                    &pairs);
+    } else {
+        match_approximate(large_points, large.size(), small_points, small.size(), &pairs);
+    }
+
+    if (swapped) {
+        for (size_t i = 0; i < pairs.size(); i++) {
+            std::swap(pairs[i].first, pairs[i].second);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    result->from.resize(pairs.size());
+    result->to.resize(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        result->from[i] = pairs[i].first;
+        result->to[i] = pairs[i].second;
+    }
+}
+
+double correspondence_cost(const Correspondence& pairs, const PointCloud& from, const PointCloud& to) {
+    Points a(from), b(to);
+    double sum = 0.0;
+    for (int i = 0; i < pairs.size(); i++) {
+        sum += distance2(a, pairs.from[i], b, pairs.to[i]);
+    }
+    return sum;
+}
+
+void pair_points(const Correspondence& pairs, const PointCloud& from, const PointCloud& to,
+                 PointCloud* from_out, PointCloud* to_out) {
+    from_out->resize(pairs.size());
+    to_out->resize(pairs.size());
+    for (int c = 0; c < PointCloud::CHANNELS; c++) {
+        const float* a = from.channel(c);
+        const float* b = to.channel(c);
+        float* a_out = from_out->channel(c);
+        float* b_out = to_out->channel(c);
+        for (int i = 0; i < pairs.size(); i++) {
+            a_out[i] = a[pairs.from[i]];
+            b_out[i] = b[pairs.to[i]];
+        }
+    }
+}
+
+/**
+ * FNV-1a over both models' positions and the mode
+ */
+static uint64_t model_hash(const PointCloud& from, const PointCloud& to, MatchMode mode) {
+    uint64_t hash = 14695981039346656037ULL;
+    struct Block {
+        const void* data;
+        size_t size;
+    };
+    int counts[3] = {from.size(), to.size(), static_cast<int>(mode)};
+    const Block blocks[] = {
+        {counts, sizeof(counts)},
+        {from.x(), from.size() * sizeof(float)}, {from.y(), from.size() * sizeof(float)},
+        {from.z(), from.size() * sizeof(float)},
+        {to.x(), to.size() * sizeof(float)}, {to.y(), to.size() * sizeof(float)},
+        {to.z(), to.size() * sizeof(float)},
+    };
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        const unsigned char* p = static_cast<const unsigned char*>(blocks[b].data);
+        for (size_t i = 0; i < blocks[b].size; i++) {
+            hash = (hash ^ p[i]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Fixed 32-byte header of a cache file
+ */
+struct CacheHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t mode;
+    uint32_t from_count;
+    uint32_t to_count;
+    uint32_t pairs;
+    uint32_t reserved;
+    uint64_t hash;
+};
+
+std::string correspondence_cache_path(const std::string& directory, const PointCloud& from,
+                                      const PointCloud& to, MatchMode mode) {
+    char name[64];
+    snprintf(name, sizeof(name), "match_%016llx.c64m",
+             static_cast<unsigned long long>(model_hash(from, to, resolve(mode, from, to))));
+    return directory.empty() ? name : directory + "/" + name;
+}
+
+bool save_correspondence(const std::string& path, const PointCloud& from, const PointCloud& to,
+                         MatchMode mode, const Correspondence& pairs) {
+    mode = resolve(mode, from, to);
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "C64M", 4);
+    header.version = CORRESPONDENCE_FILE_VERSION;
+    header.mode = static_cast<uint16_t>(mode);
+    header.from_count = from.size();
+    header.to_count = to.size();
+    header.pairs = pairs.size();
+    header.hash = model_hash(from, to, mode);
+
+    // Write to a temporary name first, so readers never see half a file
+    std::string temporary = path + ".tmp";
+    FILE* fp = fopen(temporary.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (pairs.size() > 0) {
+        ok = ok && fwrite(&pairs.from[0], sizeof(int), pairs.size(), fp) == pairs.from.size();
+        ok = ok && fwrite(&pairs.to[0], sizeof(int), pairs.size(), fp) == pairs.to.size();
+    }
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load_correspondence(const std::string& path, const PointCloud& from, const PointCloud& to,
+                         MatchMode mode, Correspondence* pairs) {
+    mode = resolve(mode, from, to);
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    CacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              std::memcmp(header.magic, "C64M", 4) == 0 &&
+              header.version == CORRESPONDENCE_FILE_VERSION &&
+              header.mode == mode &&
+              header.from_count == static_cast<uint32_t>(from.size()) &&
+              header.to_count == static_cast<uint32_t>(to.size()) &&
+              header.pairs == static_cast<uint32_t>(std::max(from.size(), to.size())) &&
+              header.hash == model_hash(from, to, mode);
+    if (ok && header.pairs > 0) {
+        pairs->from.resize(header.pairs);
+        pairs->to.resize(header.pairs);
+        ok = fread(&pairs->from[0], sizeof(int), header.pairs, fp) == header.pairs &&
+             fread(&pairs->to[0], sizeof(int), header.pairs, fp) == header.pairs;
+    }
+    fclose(fp);
+
+    // Every index must be in range
+    for (size_t i = 0; ok && i < header.pairs; i++) {
+        ok = pairs->from[i] >= 0 && pairs->from[i] < from.size() && pairs->to[i] >= 0 && pairs->to[i] < to.size();
+    }
+    if (!ok) {
+        pairs->from.clear();
+        pairs->to.clear();
+    }
+    return ok;
+}
+
+bool match_points_cached(const PointCloud& from, const PointCloud& to, MatchMode mode,
+                         const std::string& directory, Correspondence* result) {
+    std::string path = correspondence_cache_path(directory, from, to, mode);
+    if (load_correspondence(path, from, to, mode, result)) {
+        return true;
+    }
+    match_points(from, to, mode, result);
+    if (!directory.empty()) {
+        mkdir(directory.c_str(), 0755);
+    }
+    save_correspondence(path, from, to, mode, *result);
+    return false;
+}
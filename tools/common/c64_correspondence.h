@@ -0,0 +1,118 @@
+/*
+ * Vertex correspondence for morphing between point models
+ *
+ * Pairing the points of two models by index only works when both have the
+ * same count and were generated in matching order; otherwise the points
+ * cross the whole model on tangled paths. match_points() instead pairs
+ * them so that the total squared travel distance is minimal. With that
+ * cost no two points meet halfway along their straight paths.
+ *
+ * Models of different sizes are paired too: every point of the larger model
+ * gets exactly one partner and every point of the smaller one at least one,
+ * so points of the smaller model split up (or, morphing the other way,
+ * merge). The result has as many pairs as the larger model has points:
+ *
+ *   Correspondence pairs;
+ *   match_points_cached(torus, star, MATCH_AUTO, "morph_cache", &pairs);
+ *   pair_points(pairs, torus, star, &from, &to);   // equal sized clouds
+ *   morph_points(from, to, t, &current);
+ *
+ * Exact matching uses the Hungarian algorithm, O(n^3). The approximate mode
+ * bisects both sets in the same proportion along the longest axis until
+ * the blocks are small, matches each block exactly, then improves the
+ * result over differently cut blocks until a round of passes gains less
+ * than 1%. Measured against exact matching, a sphere morphing into a torus
+ * (700-1200 points) costs under 1% of extra travel, uniform random clouds of
+ * the same size 6-9%, and two nearly identical clouds none. 50000 points
+ * take about 9 s. MATCH_AUTO is exact up to MATCH_EXACT_LIMIT points.
+ *
+ * Cache files (.c64m) store the pairs under a hash of both models' positions:
+ *
+ *   offset  size  field
+ *   0       4     magic "C64M"
+ *   4       2     version (1)
+ *   6       2     mode the pairs were computed with
+ *   8       4     point count of the first model
+ *   12      4     point count of the second model
+ *   16      4     pair count
+ *   20      4     reserved (zero)
+ *   24      8     model hash (also part of the file name)
+ *   32            pair count int32 indices into the first model, then
+ *                 pair count int32 indices into the second model
+ *
+ * All values are little endian.
+ */
+
+#ifndef C64_CORRESPONDENCE_H
+#define C64_CORRESPONDENCE_H
+
+#include "c64_morph.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum MatchMode {
+    MATCH_AUTO,
+    MATCH_EXACT,
+    MATCH_APPROXIMATE
+};
+
+const int MATCH_EXACT_LIMIT = 512;
+const int CORRESPONDENCE_FILE_VERSION = 1;
+
+/**
+ * Pairs of point indices, sorted by the index into the first model
+ */
+struct Correspondence {
+    std::vector<int> from;
+    std::vector<int> to;
+
+    int size() const {
+        return static_cast<int>(from.size());
+    }
+};
+
+/**
+ * Pair the points of two non-empty models with minimal total squared travel
+ * (approximately minimal in MATCH_APPROXIMATE)
+ */
+void match_points(const PointCloud& from, const PointCloud& to, MatchMode mode, Correspondence* result);
+
+/**
+ * Sum of the squared distances between the paired points
+ */
+double correspondence_cost(const Correspondence& pairs, const PointCloud& from, const PointCloud& to);
+
+/**
+ * Build two clouds of pairs.size() points each, where point i of from_out
+ * and to_out are the points of pair i; allocates, so call while setting up
+ */
+void pair_points(const Correspondence& pairs, const PointCloud& from, const PointCloud& to,
+                 PointCloud* from_out, PointCloud* to_out);
+
+/**
+ * Cache file for a model pair: directory/match_<hash>.c64m
+ */
+std::string correspondence_cache_path(const std::string& directory, const PointCloud& from,
+                                      const PointCloud& to, MatchMode mode);
+
+bool save_correspondence(const std::string& path, const PointCloud& from, const PointCloud& to,
+                         MatchMode mode, const Correspondence& pairs);
+
+/**
+ * Load pairs saved for exactly these models; false if the file is missing,
+ * belongs to other models or is damaged
+ */
+bool load_correspondence(const std::string& path, const PointCloud& from, const PointCloud& to,
+                         MatchMode mode, Correspondence* pairs);
+
+/**
+ * match_points() through a cache directory (created if needed)
+ * Returns true if the pairs came from the cache. A cache that cannot be
+ * written only costs the time to match again next run.
+ */
+bool match_points_cached(const PointCloud& from, const PointCloud& to, MatchMode mode,
+                         const std::string& directory, Correspondence* result);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Headless rendering for the GLUT demos
+ * See c64_headless.h.
+ */
+
+#include "c64_headless.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/glut.h>
+#include <GL/gl.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static bool active = false;
+
+bool headless_active() {
+    return active;
+}
+
+void present_frame() {
+    if (active) {
+        glFlush();
+    } else {
+        glutSwapBuffers();
+    }
+}
+
+bool parse_headless_args(int* argc, char** argv, HeadlessOptions* options) {
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless" || arg == "--capture") {
+            if (i + 1 >= *argc) {
+                std::cerr << arg << " needs a value" << std::endl;
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--capture") {
+                options->capture = value;
+                continue;
+            }
+            char* end = NULL;
+            long frames = strtol(value, &end, 10);
+            if (*end != '\0' || frames <= 0 || frames > 1000000000L) {
+                std::cerr << "--headless needs a frame count, not " << value << std::endl;
+                return false;
+            }
+            options->frames = static_cast<int>(frames);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+
+    if (!options->capture.empty() && options->frames == 0) {
+        std::cerr << "--capture needs --headless FRAMES" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Connect to EGL without a window system
+ * Prefers Mesa's surfaceless platform and falls back to the default display.
+ */
+static EGLDisplay open_display() {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+            return display;
+        }
+    }
+#endif
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+/**
+ * Write the current frame as a top-down PPM
+ */
+static bool capture_frame(const std::string& prefix, int frame, int width, int height,
+                          std::vector<unsigned char>* pixels, std::vector<unsigned char>* flipped) {
+    size_t row = static_cast<size_t>(width) * 3;
+    pixels->resize(row * height);
+    flipped->resize(row * height);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &(*pixels)[0]);
+    for (int y = 0; y < height; y++) {
+        std::memcpy(&(*flipped)[y * row], &(*pixels)[(height - 1 - y) * row], row);
+    }
+
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s_%06d.ppm", prefix.c_str(), frame);
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    bool ok = fwrite(&(*flipped)[0], 1, flipped->size(), fp) == flipped->size();
+    return fclose(fp) == 0 && ok;
+}
+
+int run_headless(const HeadlessOptions& options, int width, int height, const HeadlessScene& scene) {
+    EGLDisplay display = open_display();
+    if (display == EGL_NO_DISPLAY) {
+        std::cerr << "Headless rendering needs EGL, no EGL display found" << std::endl;
+        return 1;
+    }
+
+    const EGLint config_attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    const EGLint surface_attributes[] = {
+        EGL_WIDTH, width,
+        EGL_HEIGHT, height,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configs = 0;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &configs) || configs == 0 ||
+        !eglBindAPI(EGL_OPENGL_API) ||
+        (surface = eglCreatePbufferSurface(display, config, surface_attributes)) == EGL_NO_SURFACE ||
+        (context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL)) == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "Could not create a headless OpenGL context (EGL error 0x" << std::hex << eglGetError()
+                  << std::dec << ")" << std::endl;
+        eglTerminate(display);
+        return 1;
+    }
+
+    std::cout << "Headless rendering " << options.frames << " frames at " << width << "x" << height
+              << " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+
+    active = true;
+    scene.reshape(width, height);
+    scene.init();
+
+    int status = 0;
+    int rendered = 0;
+    std::vector<unsigned char> pixels, flipped;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < options.frames; frame++) {
+        if (scene.advance) {
+            scene.advance();
+        }
+        scene.display();
+        if (!options.capture.empty() &&
+            !capture_frame(options.capture, frame, width, height, &pixels, &flipped)) {
+            std::cerr << "Could not write frame " << frame << " to " << options.capture << "_*.ppm" << std::endl;
+            status = 1;
+            break;
+        }
+        rendered++;
+    }
+    glFinish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Rendered " << rendered << " frames in " << seconds << " s ("
+              << rendered / seconds << " frames/s)" << std::endl;
+
+    // finish() also runs after a failed capture, so the demo can release what it holds
+    if (scene.finish && !scene.finish()) {
+        status = 1;
+    }
+    active = false;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglDestroySurface(display, surface);
+    eglTerminate(display);
+    return status;
+}
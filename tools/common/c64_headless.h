@@ -0,0 +1,68 @@
+/*
+ * Headless rendering for the GLUT demos
+ *
+ * The demos draw with plain OpenGL from GLUT callbacks and are paced by
+ * glutTimerFunc(). For precalculation they can instead run without a
+ * window: an EGL pbuffer context (Mesa's surfaceless platform, so no X
+ * display is needed) receives the same reshape/init/display calls, and the
+ * frames are rendered back to back as fast as the renderer allows.
+ *
+ *   ./demo --headless 1000                    render 1000 frames
+ *   ./demo --headless 1000 --capture frames/f write them as f_000000.ppm ...
+ *
+ * display() must call present_frame() instead of glutSwapBuffers().
+ */
+
+#ifndef C64_HEADLESS_H
+#define C64_HEADLESS_H
+
+#include <string>
+
+struct HeadlessOptions {
+    int frames;             // frames to render; 0 runs the interactive GLUT version
+    std::string capture;    // prefix for captured PPM frames, empty for none
+
+    HeadlessOptions() : frames(0) {}
+};
+
+/**
+ * The callbacks of a demo
+ * advance() is what the GLUT timer does between two frames (without
+ * glutPostRedisplay/glutTimerFunc); it runs before every display().
+ * finish() runs after the last frame while the context is still current,
+ * also when capturing a frame failed; it returns false if it failed itself
+ * (e.g. could not write its output). Either failure makes run_headless()
+ * return 1. advance and finish may be NULL.
+ */
+struct HeadlessScene {
+    void (*reshape)(int width, int height);
+    void (*init)();
+    void (*display)();
+    void (*advance)();
+    bool (*finish)();
+};
+
+/**
+ * Take --headless FRAMES and --capture PREFIX out of the command line
+ * Other arguments are left for the demo (and glutInit). Returns false
+ * after printing an error for malformed options.
+ */
+bool parse_headless_args(int* argc, char** argv, HeadlessOptions* options);
+
+/**
+ * Render options.frames frames of the scene without a window
+ * Returns the exit code for main().
+ */
+int run_headless(const HeadlessOptions& options, int width, int height, const HeadlessScene& scene);
+
+/**
+ * True while run_headless() is rendering
+ */
+bool headless_active();
+
+/**
+ * End of a frame: glutSwapBuffers() in a window, glFlush() when headless
+ */
+void present_frame();
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Point cloud morphing with precomputed C64 coordinate tables
+ * See c64_morph.h.
+ */
+
+#include "c64_morph.h"
+
+#include <cstdio>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+PointCloud::PointCloud(int count) : count_(0), stride_(0) {
+    resize(count);
+}
+
+void PointCloud::resize(int count) {
+    count_ = count;
+    stride_ = (count + 3) & ~3;
+    // One spare float keeps &data_[0] valid for an empty cloud
+    data_.assign(static_cast<size_t>(CHANNELS) * stride_ + 1, 0.0f);
+}
+
+void PointCloud::set(int i, float x, float y, float z, float red, float green, float blue) {
+    float* p = &data_[0] + i;
+    p[X * stride_] = x;
+    p[Y * stride_] = y;
+    p[Z * stride_] = z;
+    p[RED * stride_] = red;
+    p[GREEN * stride_] = green;
+    p[BLUE * stride_] = blue;
+}
+
+void morph_points(const PointCloud& from, const PointCloud& to, float t, PointCloud* out) {
+    // All six channels lie back to back, so one loop covers them
+    const float* a = &from.data_[0];
+    const float* b = &to.data_[0];
+    float* result = &out->data_[0];
+    const int n = PointCloud::CHANNELS * out->stride_;
+    int i = 0;
+
+#if defined(__SSE2__)
+    // n is a multiple of 4, the padding between channels is morphed too
+    const __m128 vt = _mm_set1_ps(t);
+    for (; i < n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(result + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+    }
+#endif
+    for (; i < n; i++) {
+        result[i] = a[i] + (b[i] - a[i]) * t;
+    }
+}
+
+void smoothstep_table(int frames, float* progress) {
+    for (int i = 0; i < frames; i++) {
+        float t = (float)i / (float)frames;
+        progress[i] = t * t * (3.0f - 2.0f * t);
+    }
+}
+
+MorphTable::MorphTable() : frames_(0), points_(0) {
+}
+
+void MorphTable::resize(int frames, int points) {
+    frames_ = frames;
+    points_ = points;
+    rows_.assign(static_cast<size_t>(frames) * points * 2, 0);
+}
+
+void MorphTable::record(int frame, const Projection& projection, const PointCloud& cloud,
+                        int offset_x, int offset_y) {
+    int16_t* row = &rows_[static_cast<size_t>(frame) * points_ * 2];
+    project_points_c64(projection, cloud.x(), cloud.y(), cloud.z(), points_, offset_x, offset_y,
+                       row, row + points_, NULL);
+}
+
+bool MorphTable::write(const std::string& path) const {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    // Little endian on every machine these tools run on
+    bool ok = fwrite(&rows_[0], sizeof(int16_t), rows_.size(), fp) == rows_.size();
+    return fclose(fp) == 0 && ok;
+}
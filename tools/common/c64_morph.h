@@ -0,0 +1,125 @@
+/*
+ * Point cloud morphing with precomputed C64 coordinate tables
+ *
+ * A PointCloud keeps positions and colours as six separate float arrays
+ * (structure of arrays) in one block of memory, allocated once. Morphing
+ * two clouds is then a single linear interpolation over that block, four
+ * floats at a time with SSE, into a cloud that is reused every frame:
+ *
+ *   PointCloud torus(64), star(64), current(64);  // the only allocations
+ *   ...
+ *   morph_points(torus, star, progress, &current); // every frame
+ *
+ * A MorphTable holds the projected, quantized screen coordinates of a whole
+ * animation cycle: one row per frame with all x values followed by all y
+ * values (int16). This is the table a C64 demo loads instead of doing any
+ * 3D maths itself. write() stores it as raw little endian rows, frame after
+ * frame, without a header.
+ */
+
+#ifndef C64_MORPH_H
+#define C64_MORPH_H
+
+#include "c64_projection.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class PointCloud {
+public:
+    enum Channel { X, Y, Z, RED, GREEN, BLUE, CHANNELS };
+
+    explicit PointCloud(int count = 0);
+
+    /**
+     * Allocate room for count points, all zero; call while setting up, not
+     * per frame
+     */
+    void resize(int count);
+
+    int size() const {
+        return count_;
+    }
+
+    // Each channel is count floats, the next one starts at a multiple of 4
+    float* channel(int c) {
+        return &data_[0] + c * stride_;
+    }
+    const float* channel(int c) const {
+        return &data_[0] + c * stride_;
+    }
+
+    float* x() { return channel(X); }
+    float* y() { return channel(Y); }
+    float* z() { return channel(Z); }
+    const float* x() const { return channel(X); }
+    const float* y() const { return channel(Y); }
+    const float* z() const { return channel(Z); }
+
+    void set(int i, float x, float y, float z, float red, float green, float blue);
+
+private:
+    friend void morph_points(const PointCloud& from, const PointCloud& to, float t, PointCloud* out);
+
+    int count_;
+    int stride_;                // count rounded up to a multiple of 4
+    std::vector<float> data_;   // CHANNELS * stride floats
+};
+
+/**
+ * out = from + (to - from) * t for every position and colour
+ * All three clouds must have the same size; out may be from or to.
+ * Results match the scalar formula exactly.
+ */
+void morph_points(const PointCloud& from, const PointCloud& to, float t, PointCloud* out);
+
+/**
+ * Smoothstep easing 3t^2 - 2t^3 for frame i / frames, i = 0 .. frames - 1,
+ * so morph progress is looked up instead of recomputed every frame
+ */
+void smoothstep_table(int frames, float* progress);
+
+class MorphTable {
+public:
+    MorphTable();
+
+    /**
+     * Allocate frames rows of points coordinates
+     */
+    void resize(int frames, int points);
+
+    /**
+     * Project a cloud into row frame (see project_points_c64())
+     */
+    void record(int frame, const Projection& projection, const PointCloud& cloud, int offset_x, int offset_y);
+
+    const int16_t* screen_x(int frame) const {
+        return &rows_[static_cast<size_t>(frame) * points_ * 2];
+    }
+    const int16_t* screen_y(int frame) const {
+        return screen_x(frame) + points_;
+    }
+
+    int frames() const {
+        return frames_;
+    }
+    int points() const {
+        return points_;
+    }
+    size_t bytes() const {
+        return rows_.size() * sizeof(int16_t);
+    }
+
+    /**
+     * Write all rows to path; false if the file could not be written
+     */
+    bool write(const std::string& path) const;
+
+private:
+    int frames_;
+    int points_;
+    std::vector<int16_t> rows_;
+};
+
+#endif
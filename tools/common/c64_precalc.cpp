@@ -0,0 +1,411 @@
+/*
+ * C64 data tables from projected coordinates
+ * See c64_precalc.h.
+ */
+
+#include "c64_precalc.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+namespace {
+
+    const int VALUES_PER_LINE = 16;
+
+    // One table of the output, row bytes per frame (or one row for an index)
+    struct Stream {
+        const char* name;
+        int row;
+        bool frames;
+        std::vector<uint8_t> bytes;
+    };
+
+    // Frame as a sorted list of its shown points, x and y packed into one int
+    typedef std::vector<int32_t> FrameKey;
+
+    std::string upper(const std::string& text) {
+        std::string result = text;
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i] = static_cast<char>(toupper(static_cast<unsigned char>(result[i])));
+        }
+        return result;
+    }
+
+    void add_stream(std::vector<Stream>* streams, const char* name, int row, int frames) {
+        Stream stream;
+        stream.name = name;
+        stream.row = row;
+        stream.frames = true;
+        stream.bytes.assign(static_cast<size_t>(row) * frames, 0);
+        streams->push_back(stream);
+    }
+
+    void add_index(std::vector<Stream>* streams, const char* name, const std::vector<uint8_t>& bytes) {
+        Stream stream;
+        stream.name = name;
+        stream.row = static_cast<int>(bytes.size());
+        stream.frames = false;
+        stream.bytes = bytes;
+        streams->push_back(stream);
+    }
+
+    // Whether a point lands on the raster; hidden points are written as blanks
+    bool shown(const PrecalcOptions& options, int x, int y, unsigned char visible) {
+        x += options.offset_x;
+        y += options.offset_y;
+        if (options.raster == RASTER_SPRITE) {
+            return visible && x >= 0 && x <= 511 && y >= 0 && y <= 255;
+        }
+        return visible && x >= 0 && x < 320 && y >= 0 && y < 200;
+    }
+
+    // Shown points of a frame, mirrored by flip; false if a point is hidden
+    // and flip is not 0 (a mirrored blank would show)
+    bool frame_key(const PrecalcTable& table, int frame, const PrecalcOptions& options, int flip, FrameKey* key) {
+        const int16_t* sx = table.screen_x(frame);
+        const int16_t* sy = table.screen_y(frame);
+        const unsigned char* visible = table.visible(frame);
+        key->clear();
+        for (int i = 0; i < table.points(); i++) {
+            if (!shown(options, sx[i], sy[i], visible[i])) {
+                if (flip) {
+                    return false;
+                }
+                continue;
+            }
+            int x = flip & FLIP_X ? options.screen_width - 1 - sx[i] : sx[i];
+            int y = flip & FLIP_Y ? options.screen_height - 1 - sy[i] : sy[i];
+            key->push_back(static_cast<int32_t>(static_cast<uint32_t>(x & 0xffff) << 16 | (y & 0xffff)));
+        }
+        std::sort(key->begin(), key->end());
+        return true;
+    }
+
+    // Replace every row after the first by its difference to the row before,
+    // back to front so each difference uses the original previous row
+    void delta_pack(Stream* stream, int frames) {
+        for (int frame = frames - 1; frame > 0; frame--) {
+            uint8_t* row = &stream->bytes[static_cast<size_t>(frame) * stream->row];
+            const uint8_t* previous = row - stream->row;
+            for (int i = 0; i < stream->row; i++) {
+                row[i] = static_cast<uint8_t>(row[i] - previous[i]);
+            }
+        }
+    }
+
+    void write_stream(FILE* fp, const Stream& stream, const std::string& label, int frames, AsmSyntax syntax) {
+        const char* comment = syntax == SYNTAX_KICKASS ? "//" : ";";
+        const char* directive = syntax == SYNTAX_KICKASS ? ".byte" : "!byte";
+
+        fprintf(fp, "\n%s_%s:\n", label.c_str(), stream.name);
+        if (!stream.frames) {
+            frames = 1;
+        }
+        for (int frame = 0; frame < frames; frame++) {
+            if (stream.frames) {
+                fprintf(fp, "%s frame %d\n", comment, frame);
+            }
+            const uint8_t* row = &stream.bytes[static_cast<size_t>(frame) * stream.row];
+            for (int i = 0; i < stream.row; i++) {
+                if (i % VALUES_PER_LINE == 0) {
+                    fprintf(fp, "%s $%02x", directive, row[i]);
+                } else {
+                    fprintf(fp, ",$%02x", row[i]);
+                }
+                if (i % VALUES_PER_LINE == VALUES_PER_LINE - 1 || i == stream.row - 1) {
+                    fputc('\n', fp);
+                }
+            }
+        }
+    }
+
+}
+
+bool parse_precalc_args(int* argc, char** argv, PrecalcOptions* options) {
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--precalc") {
+            if (i + 1 >= *argc) {
+                std::cerr << "--precalc needs a raster, sprite or char" << std::endl;
+                return false;
+            }
+            std::string raster = argv[++i];
+            if (raster == "sprite") {
+                options->raster = RASTER_SPRITE;
+                options->offset_x = 24;
+                options->offset_y = 50;
+            } else if (raster == "char") {
+                options->raster = RASTER_CHAR;
+                options->offset_x = 0;
+                options->offset_y = 0;
+            } else {
+                std::cerr << "--precalc needs a raster, sprite or char, not " << raster << std::endl;
+                return false;
+            }
+            options->enabled = true;
+        } else if (arg == "--kickass") {
+            options->syntax = SYNTAX_KICKASS;
+        } else if (arg == "--delta") {
+            options->delta = true;
+        } else if (arg == "--dedup") {
+            options->dedup = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+
+    if (!options->enabled && (options->syntax != SYNTAX_ACME || options->delta || options->dedup)) {
+        std::cerr << "--kickass, --delta and --dedup need --precalc sprite|char" << std::endl;
+        return false;
+    }
+    if (options->delta && options->dedup) {
+        std::cerr << "--delta and --dedup exclude each other" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const char* raster_name(RasterMode raster) {
+    return raster == RASTER_CHAR ? "char" : "sprite";
+}
+
+PrecalcTable::PrecalcTable() : frames_(0), points_(0) {
+}
+
+void PrecalcTable::resize(int frames, int points) {
+    frames_ = frames;
+    points_ = points;
+    x_.assign(static_cast<size_t>(frames) * points, 0);
+    y_.assign(static_cast<size_t>(frames) * points, 0);
+    visible_.assign(static_cast<size_t>(frames) * points, 0);
+}
+
+void PrecalcTable::record(int frame, const int16_t* screen_x, const int16_t* screen_y,
+                          const unsigned char* visible) {
+    size_t row = static_cast<size_t>(frame) * points_;
+    for (int i = 0; i < points_; i++) {
+        x_[row + i] = screen_x[i];
+        y_[row + i] = screen_y[i];
+        visible_[row + i] = visible ? visible[i] : 1;
+    }
+}
+
+int FrameAnalysis::mirrored() const {
+    int count = 0;
+    for (size_t i = 0; i < flip.size(); i++) {
+        count += flip[i] != 0;
+    }
+    return count;
+}
+
+void analyze_frames(const PrecalcTable& table, const PrecalcOptions& options, FrameAnalysis* analysis) {
+    const int frames = table.frames();
+    // The char raster can only mirror a 320x200 screen (column 39 - column)
+    const bool mirrors = options.raster == RASTER_SPRITE
+        || (options.screen_width == 320 && options.screen_height == 200);
+
+    // Number the distinct frames, in order of first appearance
+    std::map<FrameKey, int> distinct;
+    std::vector<int> id(frames);
+    FrameKey key;
+    for (int frame = 0; frame < frames; frame++) {
+        frame_key(table, frame, options, 0, &key);
+        std::map<FrameKey, int>::iterator found = distinct.find(key);
+        if (found == distinct.end()) {
+            found = distinct.insert(std::make_pair(key, frame)).first;
+        }
+        id[frame] = found->second;
+    }
+
+    // Shortest cycle: the loop wraps from the last frame to the first, so
+    // the period divides the frame count
+    analysis->period = frames;
+    for (int period = 1; period < frames; period++) {
+        if (frames % period != 0) {
+            continue;
+        }
+        bool repeats = true;
+        for (int frame = period; frame < frames && repeats; frame++) {
+            repeats = id[frame] == id[frame - period];
+        }
+        if (repeats) {
+            analysis->period = period;
+            break;
+        }
+    }
+
+    // Store each frame of the period unless it or a mirror of it is stored
+    std::map<FrameKey, int> stored;
+    analysis->stored.clear();
+    analysis->frame.assign(analysis->period, 0);
+    analysis->flip.assign(analysis->period, 0);
+    const int last_flip = mirrors ? FLIP_X | FLIP_Y : 0;
+    for (int frame = 0; frame < analysis->period; frame++) {
+        std::map<FrameKey, int>::iterator found = stored.end();
+        int flip = 0;
+        for (; flip <= last_flip; flip++) {
+            if (frame_key(table, frame, options, flip, &key) && (found = stored.find(key)) != stored.end()) {
+                break;
+            }
+        }
+        if (found == stored.end()) {
+            frame_key(table, frame, options, 0, &key);
+            found = stored.insert(std::make_pair(key, static_cast<int>(analysis->stored.size()))).first;
+            analysis->stored.push_back(frame);
+            flip = 0;
+        }
+        analysis->frame[frame] = found->second;
+        analysis->flip[frame] = static_cast<unsigned char>(flip);
+    }
+}
+
+bool write_precalc(const PrecalcTable& table, const std::string& base, const std::string& label,
+                   const PrecalcOptions& options, FrameAnalysis* result) {
+    const int points = table.points();
+
+    // Recorded frames to write: all, or the distinct ones of one period
+    FrameAnalysis local;
+    FrameAnalysis& analysis = result ? *result : local;
+    std::vector<int> written;
+    if (options.dedup) {
+        analyze_frames(table, options, &analysis);
+        written = analysis.stored;
+    } else {
+        for (int frame = 0; frame < table.frames(); frame++) {
+            written.push_back(frame);
+        }
+    }
+    const int frames = static_cast<int>(written.size());
+
+    // Quantize them into the tables of the raster
+    std::vector<Stream> streams;
+    if (options.raster == RASTER_SPRITE) {
+        add_stream(&streams, "x", points, frames);
+        add_stream(&streams, "msb", (points + 7) / 8, frames);
+        add_stream(&streams, "y", points, frames);
+    } else {
+        add_stream(&streams, "column", points, frames);
+        add_stream(&streams, "row", points, frames);
+        add_stream(&streams, "bit", points, frames);
+        add_stream(&streams, "line", points, frames);
+    }
+
+    for (int frame = 0; frame < frames; frame++) {
+        const int16_t* sx = table.screen_x(written[frame]);
+        const int16_t* sy = table.screen_y(written[frame]);
+        const unsigned char* visible = table.visible(written[frame]);
+        for (int i = 0; i < points; i++) {
+            if (!shown(options, sx[i], sy[i], visible[i])) {
+                continue;   // sprite x = 0, y = 0 hides in the border; char bit 0 plots nothing
+            }
+            size_t index = static_cast<size_t>(frame) * points + i;
+            int x = sx[i] + options.offset_x;
+            int y = sy[i] + options.offset_y;
+            if (options.raster == RASTER_SPRITE) {
+                streams[0].bytes[index] = static_cast<uint8_t>(x & 0xff);
+                streams[1].bytes[static_cast<size_t>(frame) * streams[1].row + i / 8] |=
+                    static_cast<uint8_t>((x >> 8) << (i & 7));
+                streams[2].bytes[index] = static_cast<uint8_t>(y);
+            } else {
+                streams[0].bytes[index] = static_cast<uint8_t>(x >> 3);
+                streams[1].bytes[index] = static_cast<uint8_t>(y >> 3);
+                streams[2].bytes[index] = static_cast<uint8_t>(0x80 >> (x & 7));
+                streams[3].bytes[index] = static_cast<uint8_t>(y & 7);
+            }
+        }
+    }
+    if (options.delta) {
+        for (size_t s = 0; s < streams.size(); s++) {
+            delta_pack(&streams[s], frames);
+        }
+    }
+    if (options.dedup) {
+        std::vector<uint8_t> low, high;
+        for (int frame = 0; frame < analysis.period; frame++) {
+            low.push_back(static_cast<uint8_t>(analysis.frame[frame] & 0xff));
+            high.push_back(static_cast<uint8_t>(analysis.frame[frame] >> 8));
+        }
+        add_index(&streams, "frame_lo", low);
+        add_index(&streams, "frame_hi", high);
+        add_index(&streams, "flip", std::vector<uint8_t>(analysis.flip.begin(), analysis.flip.end()));
+    }
+
+    // Raw tables back to back
+    std::string path = base + ".bin";
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = true;
+    for (size_t s = 0; s < streams.size(); s++) {
+        const std::vector<uint8_t>& bytes = streams[s].bytes;
+        ok = ok && (bytes.empty() || fwrite(&bytes[0], 1, bytes.size(), fp) == bytes.size());
+    }
+    if (fclose(fp) != 0 || !ok) {
+        return false;
+    }
+
+    // The same tables as an include
+    path = base + ".i";
+    fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    const bool kickass = options.syntax == SYNTAX_KICKASS;
+    const char* comment = kickass ? "//" : ";";
+    const char* constant = kickass ? ".const " : "";
+    const std::string name = upper(label);
+
+    fprintf(fp, "%s %s: %d frames of %d points, %s coordinates%s\n", comment, label.c_str(), frames, points,
+            options.raster == RASTER_CHAR ? "char screen" : "sprite",
+            options.delta ? ", delta packed" : "");
+    if (options.dedup) {
+        fprintf(fp, "%s Distinct frames of a %d frame loop (%d recorded), %d shown mirrored\n", comment,
+                analysis.period, table.frames(), analysis.mirrored());
+    }
+    fprintf(fp, "%s Tables frame after frame; the binary %s.bin holds them back to back\n\n", comment,
+            base.substr(base.find_last_of('/') + 1).c_str());
+    fprintf(fp, "%s%s_FRAMES = %d\n", constant, name.c_str(), frames);
+    fprintf(fp, "%s%s_POINTS = %d\n", constant, name.c_str(), points);
+    fprintf(fp, "%s%s_DELTA = %d\n", constant, name.c_str(), options.delta ? 1 : 0);
+    if (options.dedup) {
+        fprintf(fp, "%s%s_SEQUENCE = %d\n", constant, name.c_str(), analysis.period);
+        // x is mirrored with its msb (9 bits), y in the 8 bit register: the
+        // low byte of the sum gives the same byte as the wrapped subtraction
+        fprintf(fp, "%s%s_MIRROR_X = %d\n", constant, name.c_str(), 2 * options.offset_x + options.screen_width - 1);
+        fprintf(fp, "%s%s_MIRROR_Y = %d\n", constant, name.c_str(),
+                (2 * options.offset_y + options.screen_height - 1) & 0xff);
+    }
+    for (size_t s = 0; s < streams.size(); s++) {
+        fprintf(fp, "%s%s_%s_SIZE = %d\n", constant, name.c_str(), upper(streams[s].name).c_str(),
+                static_cast<int>(streams[s].bytes.size()));
+    }
+    for (size_t s = 0; s < streams.size(); s++) {
+        write_stream(fp, streams[s], label, frames, options.syntax);
+    }
+
+    ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+bool write_precalc_report(const PrecalcTable& table, const std::string& base, const std::string& label,
+                          const PrecalcOptions& options) {
+    FrameAnalysis analysis;
+    if (!write_precalc(table, base, label, options, &analysis)) {
+        std::cerr << "Could not write " << base << ".i/.bin" << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << base << ".i and " << base << ".bin: " << table.frames() << " frames of "
+              << table.points() << " points" << std::endl;
+    if (options.dedup) {
+        std::cout << "Loop of " << analysis.period << " frames, " << analysis.stored.size() << " stored, "
+                  << analysis.mirrored() << " shown mirrored" << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,185 @@
+/*
+ * C64 data tables from projected coordinates
+ *
+ * A PrecalcTable collects the integer screen coordinates of every frame of
+ * an animation loop, as project_vertices_c64() / project_points_c64()
+ * return them, and writes them in one pass as the data a C64 part loads:
+ * an assembler include for ACME or KickAss and the same bytes as a raw
+ * binary.
+ *
+ *   PrecalcOptions precalc;              // from parse_precalc_args()
+ *   PrecalcTable table;
+ *   table.resize(LOOP_FRAMES, count);
+ *   table.record(frame, screenX, screenY, visible);     // every frame
+ *   write_precalc(table, "helix_sprite", "helix", precalc);    // or write_precalc_report()
+ *
+ * The coordinates are quantized for the target raster:
+ *
+ *   RASTER_SPRITE  x + 24 and y + 50 (sprite coordinates): tables x (low
+ *                  byte), msb (bit i & 7 of byte i / 8 is bit 8 of x of
+ *                  point i, ready for $d010) and y. Points off the 512x256
+ *                  sprite range or behind the eye get x = 0, y = 0, which
+ *                  hides them in the border.
+ *   RASTER_CHAR    a 320x200 screen: tables column (x / 8), row (y / 8),
+ *                  bit (the pixel's mask $80 >> (x & 7)) and line (y & 7,
+ *                  the byte within the char). Points off the screen get
+ *                  column 0, row 0 and bit 0, so plotting them sets nothing.
+ *
+ * Each table holds frames rows of one byte per point (msb: per 8 points).
+ * With delta packing, row 0 is stored as is and every later row as the
+ * difference to the previous row, modulo 256: the decoder adds each row to
+ * the last one with a plain clc/adc. Most differences of a smooth animation
+ * are small, so packed tables crunch far better.
+ *
+ * With deduplication, only one period of the loop is kept (the shortest
+ * cycle that repeats exactly) and each distinct frame is stored once. A
+ * frame that shows the same points as a stored one, in any order, reuses
+ * it; so does a frame that is a stored one mirrored about the middle of the
+ * screen (screen_width x screen_height), horizontally, vertically or both.
+ * Mirrors are only matched between frames without hidden points. The frame
+ * tables then hold the distinct frames, and three tables of one byte per
+ * frame of the period say what to show:
+ *
+ *   frame_lo, frame_hi  number of the stored frame
+ *   flip                bit 0: mirror x, bit 1: mirror y
+ *
+ * Mirrored sprite coordinates are LABEL_MIRROR_X - x (9 bits, x with its
+ * msb) and LABEL_MIRROR_Y - y modulo 256; LABEL_MIRROR_Y is written as a
+ * byte, ready for lda #. On the char raster, whose screen must be 320x200 for
+ * mirrors, they are column 39 - column with the bit mask reversed, and row
+ * 24 - row with line 7 - line. Playback jumps between frames, so delta
+ * packing and deduplication exclude each other.
+ *
+ * The binary holds the tables back to back in the order above, the index
+ * tables last; the include defines LABEL_FRAMES, LABEL_POINTS, LABEL_DELTA,
+ * the size of every table (LABEL_X_SIZE, ...) and with deduplication
+ * LABEL_SEQUENCE, LABEL_MIRROR_X and LABEL_MIRROR_Y, then the labelled
+ * tables (label_x, ...).
+ */
+
+#ifndef C64_PRECALC_H
+#define C64_PRECALC_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum RasterMode {
+    RASTER_SPRITE,
+    RASTER_CHAR
+};
+
+enum AsmSyntax {
+    SYNTAX_ACME,      // ; comments, NAME = value, !byte
+    SYNTAX_KICKASS    // // comments, .const NAME = value, .byte
+};
+
+struct PrecalcOptions {
+    bool enabled;           // --precalc was given
+    RasterMode raster;
+    AsmSyntax syntax;
+    bool delta;             // delta pack rows after the first
+    bool dedup;             // one period, distinct frames and an index
+    int offset_x;           // added to the screen coordinates before quantizing
+    int offset_y;
+    int screen_width;       // the screen of the coordinates, mirrors are about its middle
+    int screen_height;
+
+    PrecalcOptions()
+        : enabled(false), raster(RASTER_SPRITE), syntax(SYNTAX_ACME), delta(false), dedup(false),
+          offset_x(24), offset_y(50), screen_width(320), screen_height(200) {}
+};
+
+enum {
+    FLIP_X = 1,
+    FLIP_Y = 2
+};
+
+/**
+ * Take --precalc sprite|char, --kickass, --delta and --dedup out of the
+ * command line
+ * Sets the offsets for the raster (24/50 for sprites, 0/0 for chars). Other
+ * arguments are left for the demo. Returns false after printing an error
+ * for malformed options.
+ */
+bool parse_precalc_args(int* argc, char** argv, PrecalcOptions* options);
+
+/**
+ * "sprite" or "char", for file names
+ */
+const char* raster_name(RasterMode raster);
+
+class PrecalcTable {
+public:
+    PrecalcTable();
+
+    /**
+     * Allocate frames rows of points coordinates, all hidden
+     */
+    void resize(int frames, int points);
+
+    /**
+     * Store the screen coordinates of one frame (row 0 at the top);
+     * visible may be NULL when every point is in front of the eye
+     */
+    void record(int frame, const int16_t* screen_x, const int16_t* screen_y, const unsigned char* visible);
+
+    const int16_t* screen_x(int frame) const {
+        return &x_[static_cast<size_t>(frame) * points_];
+    }
+    const int16_t* screen_y(int frame) const {
+        return &y_[static_cast<size_t>(frame) * points_];
+    }
+    const unsigned char* visible(int frame) const {
+        return &visible_[static_cast<size_t>(frame) * points_];
+    }
+
+    int frames() const {
+        return frames_;
+    }
+    int points() const {
+        return points_;
+    }
+
+private:
+    int frames_;
+    int points_;
+    std::vector<int16_t> x_;
+    std::vector<int16_t> y_;
+    std::vector<unsigned char> visible_;
+};
+
+/**
+ * Period and distinct frames of a recorded loop
+ */
+struct FrameAnalysis {
+    int period;                     // frames until the loop repeats exactly
+    std::vector<int> stored;        // recorded frame numbers to keep, in order
+    std::vector<int> frame;         // per frame of the period: index into stored
+    std::vector<unsigned char> flip;    // per frame of the period: FLIP_X | FLIP_Y
+
+    int mirrored() const;           // frames of the period shown mirrored
+};
+
+/**
+ * Find the period and the distinct frames of the table as they appear on
+ * the options' raster (see the description of deduplication above)
+ */
+void analyze_frames(const PrecalcTable& table, const PrecalcOptions& options, FrameAnalysis* analysis);
+
+/**
+ * Quantize the table and write base.i (include, tables named label_...)
+ * and base.bin; false if a file could not be written
+ * With options.dedup, analysis (may be NULL) receives what was stored.
+ */
+bool write_precalc(const PrecalcTable& table, const std::string& base, const std::string& label,
+                   const PrecalcOptions& options, FrameAnalysis* analysis = NULL);
+
+/**
+ * write_precalc() for the demos: print what was written (with --dedup the
+ * period and the stored frames) or an error; false if writing failed
+ */
+bool write_precalc_report(const PrecalcTable& table, const std::string& base, const std::string& label,
+                          const PrecalcOptions& options);
+
+#endif
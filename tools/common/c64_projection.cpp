@@ -0,0 +1,201 @@
+/*
+ * Batched vertex projection for C64 coordinate export
+ * See c64_projection.h.
+ */
+
+#include "c64_projection.h"
+
+#include <GL/gl.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Vertices are deinterleaved into blocks of this size before projection
+static const int BLOCK_SIZE = 256;
+
+void projection_from_gl(Projection* projection) {
+    GLdouble modelview[16];
+    GLdouble projection_matrix[16];
+    GLint viewport[4];
+    
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection_matrix);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    projection_from_matrices(modelview, projection_matrix, viewport, projection);
+}
+
+void projection_from_matrices(const double* modelview, const double* projection_matrix,
+                              const int* viewport, Projection* projection) {
+    // Column-major product, computed in double precision once per frame
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            double sum = 0.0;
+            for (int k = 0; k < 4; k++) {
+                sum += projection_matrix[k * 4 + row] * modelview[column * 4 + k];
+            }
+            projection->matrix[column * 4 + row] = static_cast<float>(sum);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        projection->viewport[i] = static_cast<float>(viewport[i]);
+    }
+}
+
+/**
+ * Project one block of deinterleaved vertices to window coordinates
+ */
+static void project_block(const Projection& projection, const float* x, const float* y, const float* z,
+                          int count, float* win_x, float* win_y, float* win_z, float* clip_w) {
+    const float* m = projection.matrix;
+    const float* vp = projection.viewport;
+    int i = 0;
+    
+#if defined(__SSE2__)
+    const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]), m3 = _mm_set1_ps(m[3]);
+    const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]), m7 = _mm_set1_ps(m[7]);
+    const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]), m11 = _mm_set1_ps(m[11]);
+    const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]), m15 = _mm_set1_ps(m[15]);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 scale_x = _mm_set1_ps(vp[2] * 0.5f), offset_x = _mm_set1_ps(vp[0] + vp[2] * 0.5f);
+    const __m128 scale_y = _mm_set1_ps(vp[3] * 0.5f), offset_y = _mm_set1_ps(vp[1] + vp[3] * 0.5f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vz = _mm_loadu_ps(z + i);
+        __m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, vx), _mm_mul_ps(m4, vy)), _mm_add_ps(_mm_mul_ps(m8, vz), m12));
+        __m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, vx), _mm_mul_ps(m5, vy)), _mm_add_ps(_mm_mul_ps(m9, vz), m13));
+        __m128 cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, vx), _mm_mul_ps(m6, vy)), _mm_add_ps(_mm_mul_ps(m10, vz), m14));
+        __m128 cw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, vx), _mm_mul_ps(m7, vy)), _mm_add_ps(_mm_mul_ps(m11, vz), m15));
+        __m128 inv_w = _mm_div_ps(_mm_set1_ps(1.0f), cw);
+        _mm_storeu_ps(win_x + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cx, inv_w), scale_x), offset_x));
+        _mm_storeu_ps(win_y + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cy, inv_w), scale_y), offset_y));
+        if (win_z) {
+            _mm_storeu_ps(win_z + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cz, inv_w), half), half));
+        }
+        if (clip_w) {
+            _mm_storeu_ps(clip_w + i, cw);
+        }
+    }
+#endif
+    
+    // Same association as the SSE body, so a vertex projects the same in any lane
+    for (; i < count; i++) {
+        float cx = (m[0] * x[i] + m[4] * y[i]) + (m[8] * z[i] + m[12]);
+        float cy = (m[1] * x[i] + m[5] * y[i]) + (m[9] * z[i] + m[13]);
+        float cz = (m[2] * x[i] + m[6] * y[i]) + (m[10] * z[i] + m[14]);
+        float cw = (m[3] * x[i] + m[7] * y[i]) + (m[11] * z[i] + m[15]);
+        float inv_w = 1.0f / cw;
+        win_x[i] = cx * inv_w * (vp[2] * 0.5f) + (vp[0] + vp[2] * 0.5f);
+        win_y[i] = cy * inv_w * (vp[3] * 0.5f) + (vp[1] + vp[3] * 0.5f);
+        if (win_z) {
+            win_z[i] = cz * inv_w * 0.5f + 0.5f;
+        }
+        if (clip_w) {
+            clip_w[i] = cw;
+        }
+    }
+}
+
+/**
+ * Narrow to 16 bits with saturation, like the SSE pack instruction
+ */
+static int16_t saturate16(int value) {
+    return static_cast<int16_t>(std::max(-32768, std::min(32767, value)));
+}
+
+/**
+ * Copy a block of strided vertices into separate x, y and z arrays
+ */
+static void deinterleave(const float* xyz, int stride, int count, float* x, float* y, float* z) {
+    for (int i = 0; i < count; i++) {
+        x[i] = xyz[i * stride];
+        y[i] = xyz[i * stride + 1];
+        z[i] = xyz[i * stride + 2];
+    }
+}
+
+void project_vertices(const Projection& projection, const float* xyz, int stride, int count,
+                      float* win_x, float* win_y, float* win_z) {
+    float x[BLOCK_SIZE], y[BLOCK_SIZE], z[BLOCK_SIZE];
+    for (int first = 0; first < count; first += BLOCK_SIZE) {
+        int n = std::min(BLOCK_SIZE, count - first);
+        deinterleave(xyz + static_cast<long>(first) * stride, stride, n, x, y, z);
+        project_block(projection, x, y, z, n, win_x + first, win_y + first,
+                      win_z ? win_z + first : NULL, NULL);
+    }
+}
+
+/**
+ * Project one block of deinterleaved vertices to C64 screen coordinates
+ */
+static void project_block_c64(const Projection& projection, const float* x, const float* y, const float* z,
+                              int n, int offset_x, int offset_y, int16_t* screen_x, int16_t* screen_y,
+                              unsigned char* visible) {
+    float win_x[BLOCK_SIZE], win_y[BLOCK_SIZE], clip_w[BLOCK_SIZE];
+    
+    // Pixel column from the left and row from the top of the viewport
+    const float left = projection.viewport[0];
+    const float bottom = projection.viewport[1];
+    const int last_row = static_cast<int>(projection.viewport[3]) - 1;
+    
+    project_block(projection, x, y, z, n, win_x, win_y, NULL, clip_w);
+    
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 vleft = _mm_set1_ps(left), vbottom = _mm_set1_ps(bottom);
+    const __m128i column_offset = _mm_set1_epi32(offset_x);
+    const __m128i row_offset = _mm_set1_epi32(last_row + offset_y);
+    for (; i + 8 <= n; i += 8) {
+        __m128i column[2], row[2];
+        for (int half = 0; half < 2; half++) {
+            // floor() as truncation, minus one where truncation rounded up
+            __m128 fx = _mm_sub_ps(_mm_loadu_ps(win_x + i + half * 4), vleft);
+            __m128 fy = _mm_sub_ps(_mm_loadu_ps(win_y + i + half * 4), vbottom);
+            __m128i tx = _mm_cvttps_epi32(fx);
+            __m128i ty = _mm_cvttps_epi32(fy);
+            tx = _mm_add_epi32(tx, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(tx), fx)));
+            ty = _mm_add_epi32(ty, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ty), fy)));
+            column[half] = _mm_add_epi32(tx, column_offset);
+            row[half] = _mm_sub_epi32(row_offset, ty);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(screen_x + i), _mm_packs_epi32(column[0], column[1]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(screen_y + i), _mm_packs_epi32(row[0], row[1]));
+    }
+#endif
+    for (; i < n; i++) {
+        screen_x[i] = saturate16(static_cast<int>(std::floor(win_x[i] - left)) + offset_x);
+        screen_y[i] = saturate16(last_row - static_cast<int>(std::floor(win_y[i] - bottom)) + offset_y);
+    }
+    
+    if (visible) {
+        for (i = 0; i < n; i++) {
+            visible[i] = clip_w[i] > 0.0f;
+        }
+    }
+}
+
+void project_vertices_c64(const Projection& projection, const float* xyz, int stride, int count,
+                          int offset_x, int offset_y, int16_t* screen_x, int16_t* screen_y,
+                          unsigned char* visible) {
+    float x[BLOCK_SIZE], y[BLOCK_SIZE], z[BLOCK_SIZE];
+    for (int first = 0; first < count; first += BLOCK_SIZE) {
+        int n = std::min(BLOCK_SIZE, count - first);
+        deinterleave(xyz + static_cast<long>(first) * stride, stride, n, x, y, z);
+        project_block_c64(projection, x, y, z, n, offset_x, offset_y, screen_x + first, screen_y + first,
+                          visible ? visible + first : NULL);
+    }
+}
+
+void project_points_c64(const Projection& projection, const float* x, const float* y, const float* z,
+                        int count, int offset_x, int offset_y, int16_t* screen_x, int16_t* screen_y,
+                        unsigned char* visible) {
+    // Already separate arrays: no copy, only blocked for the stack buffers
+    for (int first = 0; first < count; first += BLOCK_SIZE) {
+        int n = std::min(BLOCK_SIZE, count - first);
+        project_block_c64(projection, x + first, y + first, z + first, n, offset_x, offset_y,
+                          screen_x + first, screen_y + first, visible ? visible + first : NULL);
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Batched vertex projection for C64 coordinate export
+ *
+ * gluProject() multiplies the modelview and projection matrices in double
+ * precision for every single vertex. Here both matrices are concatenated
+ * once per frame into a float matrix, and whole vertex arrays are projected
+ * four at a time with SSE (scalar code on other CPUs).
+ *
+ * Window coordinates follow gluProject(): x and y in pixels with the origin
+ * at the bottom left of the window, z as depth from 0 (near) to 1 (far).
+ * C64 screen coordinates are integer pixels relative to the top left of the
+ * viewport (rows grow downwards like the raster beam), plus an offset, e.g.
+ * the sprite coordinate origin (24, 50).
+ */
+
+#ifndef C64_PROJECTION_H
+#define C64_PROJECTION_H
+
+#include <stdint.h>
+
+/**
+ * Combined transform of one frame
+ */
+struct Projection {
+    float matrix[16];       // projection * modelview, column-major like OpenGL
+    float viewport[4];      // x, y, width, height
+};
+
+/**
+ * Set up the projection from the current OpenGL modelview and projection
+ * matrices and viewport (needs a current GL context)
+ */
+void projection_from_gl(Projection* projection);
+
+/**
+ * Set up the projection from matrices as returned by glGetDoublev()
+ */
+void projection_from_matrices(const double* modelview, const double* projection_matrix,
+                              const int* viewport, Projection* projection);
+
+/**
+ * Project count vertices to window coordinates
+ * Vertex i is read from xyz[i * stride .. i * stride + 2], so both packed
+ * xyz arrays (stride 3) and vertex structs of floats work. win_z may be
+ * NULL. Vertices at or behind the eye plane (w <= 0) get undefined values.
+ */
+void project_vertices(const Projection& projection, const float* xyz, int stride, int count,
+                      float* win_x, float* win_y, float* win_z);
+
+/**
+ * Project count vertices to integer C64 screen coordinates
+ * screen_x/screen_y receive the pixel the vertex falls into, plus
+ * offset_x/offset_y. visible (may be NULL) receives 1 for vertices in front
+ * of the eye and 0 for vertices behind it.
+ */
+void project_vertices_c64(const Projection& projection, const float* xyz, int stride, int count,
+                          int offset_x, int offset_y, int16_t* screen_x, int16_t* screen_y,
+                          unsigned char* visible);
+
+/**
+ * Project count points stored as separate x, y and z arrays (structure of
+ * arrays) to integer C64 screen coordinates, like project_vertices_c64()
+ */
+void project_points_c64(const Projection& projection, const float* x, const float* y, const float* z,
+                        int count, int offset_x, int offset_y, int16_t* screen_x, int16_t* screen_y,
+                        unsigned char* visible);
+
+#endif
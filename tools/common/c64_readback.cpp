@@ -0,0 +1,108 @@
+/*
+ * Asynchronous framebuffer readback
+ * See c64_readback.h.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+#include "c64_readback.h"
+
+#include <GL/glext.h>
+#include <cstdio>
+#include <cstring>
+
+/**
+ * Pixel buffer objects are core in OpenGL 2.1
+ */
+static bool have_pixel_buffers() {
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (!version || sscanf(version, "%d.%d", &major, &minor) != 2) {
+        return false;
+    }
+    return major > 2 || (major == 2 && minor >= 1);
+}
+
+FrameReadback::FrameReadback()
+    : x_(0), y_(0), width_(0), height_(0), depth_(0), first_(0), count_(0) {
+}
+
+void FrameReadback::init(int x, int y, int width, int height, int depth) {
+    release();
+    x_ = x;
+    y_ = y;
+    width_ = width;
+    height_ = height;
+    depth_ = depth < 1 ? 1 : depth;
+    first_ = 0;
+    count_ = 0;
+    tags_.assign(depth_, 0);
+
+    size_t size = static_cast<size_t>(width_) * height_ * 3;
+    if (have_pixel_buffers()) {
+        buffers_.resize(depth_);
+        glGenBuffers(depth_, &buffers_[0]);
+        for (int i = 0; i < depth_; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    } else {
+        staging_.assign(depth_, std::vector<unsigned char>(size));
+    }
+}
+
+void FrameReadback::release() {
+    if (!buffers_.empty()) {
+        glDeleteBuffers(static_cast<GLsizei>(buffers_.size()), &buffers_[0]);
+    }
+    buffers_.clear();
+    staging_.clear();
+    count_ = 0;
+}
+
+void FrameReadback::begin(int tag) {
+    int slot = (first_ + count_) % depth_;
+    tags_[slot] = tag;
+    count_++;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (buffers_.empty()) {
+        glReadPixels(x_, y_, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, &staging_[slot][0]);
+        return;
+    }
+    // With a pack buffer bound the last argument is an offset into it
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[slot]);
+    glReadPixels(x_, y_, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameReadback::copy_flipped(const unsigned char* source, unsigned char* pixels) const {
+    size_t row = static_cast<size_t>(width_) * 3;
+    for (int y = 0; y < height_; y++) {
+        std::memcpy(pixels + y * row, source + (height_ - 1 - y) * row, row);
+    }
+}
+
+bool FrameReadback::collect(unsigned char* pixels, int* tag) {
+    int slot = first_;
+    first_ = (first_ + 1) % depth_;
+    count_--;
+    if (tag) {
+        *tag = tags_[slot];
+    }
+
+    if (buffers_.empty()) {
+        copy_flipped(&staging_[slot][0], pixels);
+        return true;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[slot]);
+    const unsigned char* mapped = (const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    bool ok = mapped != NULL;
+    if (mapped) {
+        copy_flipped(mapped, pixels);
+        // GL_FALSE: the buffer contents were lost while mapped (e.g. mode switch)
+        ok = glUnmapBuffer(GL_PIXEL_PACK_BUFFER) == GL_TRUE;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return ok;
+}
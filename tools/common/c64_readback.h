@@ -0,0 +1,93 @@
+/*
+ * Asynchronous framebuffer readback
+ *
+ * glReadPixels() into client memory waits until the frame has been drawn
+ * and the pixels have been copied. With pixel buffer objects (OpenGL 2.1)
+ * the read only queues a copy into a buffer object and returns at once;
+ * the buffer is mapped later, when the pixels are long done. A ring of a
+ * few buffers keeps that many frames in flight:
+ *
+ *   after drawing frame N:
+ *       if (readback.full())
+ *           readback.collect(pixels, &tag);   // maps frame N - depth + 1
+ *       readback.begin(N);                    // queues the copy of frame N
+ *   at the end:
+ *       while (readback.pending())
+ *           readback.collect(pixels, &tag);
+ *
+ * collect() copies the rows top row first, so images need no extra flip.
+ * A frame whose buffer cannot be mapped, or whose contents the driver lost
+ * while it was mapped, cannot be read again: collect() returns false and
+ * the caller decides what to do with the missing frame.
+ * Without pixel buffer objects begin() reads synchronously into a staging
+ * buffer and the interface works the same.
+ */
+
+#ifndef C64_READBACK_H
+#define C64_READBACK_H
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <vector>
+
+class FrameReadback {
+public:
+    FrameReadback();
+
+    /**
+     * Set up a ring of depth buffers for RGB reads of the given window
+     * region (needs a current GL context)
+     */
+    void init(int x, int y, int width, int height, int depth);
+
+    /**
+     * Queue the read of the current framebuffer, tagged e.g. with the frame
+     * number; the ring must not be full
+     */
+    void begin(int tag);
+
+    /**
+     * Copy the oldest queued frame to pixels (width * height * 3 bytes,
+     * top row first) and store its tag (tag may be NULL)
+     * Returns false if the frame could not be read; pixels are then left
+     * as they were, or partly overwritten when the data was lost.
+     */
+    bool collect(unsigned char* pixels, int* tag = NULL);
+
+    bool full() const {
+        return count_ == depth_;
+    }
+    bool pending() const {
+        return count_ > 0;
+    }
+    bool asynchronous() const {
+        return !buffers_.empty();
+    }
+
+    int width() const {
+        return width_;
+    }
+    int height() const {
+        return height_;
+    }
+
+    // Delete the buffer objects (needs the GL context)
+    void release();
+
+private:
+    // Not copyable
+    FrameReadback(const FrameReadback&);
+    FrameReadback& operator=(const FrameReadback&);
+
+    void copy_flipped(const unsigned char* source, unsigned char* pixels) const;
+
+    int x_, y_, width_, height_;
+    int depth_;
+    int first_;     // oldest queued slot
+    int count_;     // queued slots
+    std::vector<GLuint> buffers_;                   // pixel buffer objects, empty without
+    std::vector<std::vector<unsigned char> > staging_;  // synchronous fallback
+    std::vector<int> tags_;
+};
+
+#endif
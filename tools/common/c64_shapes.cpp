@@ -0,0 +1,64 @@
+/*
+ * Compile-time vertex tables for parametric demo objects
+ * See c64_shapes.h.
+ */
+
+#include "c64_shapes.h"
+
+#include <cctype>
+#include <cstdio>
+
+namespace shapes {
+
+namespace {
+
+    const int VALUES_PER_LINE = 16;
+
+    std::string upper(const std::string& text) {
+        std::string result = text;
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i] = static_cast<char>(toupper(static_cast<unsigned char>(result[i])));
+        }
+        return result;
+    }
+
+    void write_bytes(FILE* fp, const std::string& name, const Point3i* points, int count, int axis) {
+        fprintf(fp, "\n%s:\n", name.c_str());
+        for (int i = 0; i < count; i++) {
+            const int* p = &points[i].x;
+            fprintf(fp, "%s$%02x", i % VALUES_PER_LINE == 0 ? "!byte " : ",", p[axis] & 0xff);
+            if (i % VALUES_PER_LINE == VALUES_PER_LINE - 1 || i == count - 1) {
+                fputc('\n', fp);
+            }
+        }
+    }
+
+}
+
+bool write_vertex_include(const std::string& path, const std::string& label, const std::string& comment,
+                          const Point3i* points, int count) {
+    for (int i = 0; i < count; i++) {
+        const int* p = &points[i].x;
+        for (int axis = 0; axis < 3; axis++) {
+            if (p[axis] < -128 || p[axis] > 127) {
+                return false;
+            }
+        }
+    }
+
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "; %s\n", comment.c_str());
+    fprintf(fp, "; %d vertices, signed bytes, generated from c64_shapes.h by tools/shape-tables\n\n", count);
+    fprintf(fp, "%s_COUNT = %d\n", upper(label).c_str(), count);
+    write_bytes(fp, label + "_x", points, count, 0);
+    write_bytes(fp, label + "_y", points, count, 1);
+    write_bytes(fp, label + "_z", points, count, 2);
+
+    bool ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+}
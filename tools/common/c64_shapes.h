@@ -0,0 +1,514 @@
+/*
+ * Compile-time vertex tables for parametric demo objects
+ *
+ * Every shape is a small literal class with the parameters of the object
+ * and a constexpr vertex(i). generate<N>() expands it into a table of N
+ * vertices while compiling, so a demo starts with its vertex array already
+ * in the data segment; nothing is computed at startup:
+ *
+ *   constexpr auto HELIX = shapes::generate<shapes::CYLINDER_HELIX.count()>(shapes::CYLINDER_HELIX);
+ *   constexpr auto HELIX_INT = shapes::truncated(HELIX);   // GLint coordinates
+ *
+ * The same tables are written as C64 include files (write_vertex_include(),
+ * c64_shapes.cpp) by tools/shape-tables, so the demos and the C64 data come
+ * from one definition. The objects the
+ * demos use are defined at the end of this file.
+ *
+ * Only C++11 constexpr is used: functions are single expressions, loops are
+ * recursion, and sin/cos/sqrt are evaluated by series in double precision.
+ * Shapes compute in float where the original runtime code did, so the
+ * tables equal what that code produced.
+ */
+
+#ifndef C64_SHAPES_H
+#define C64_SHAPES_H
+
+#include <string>
+
+namespace shapes {
+
+constexpr double PI = 3.14159265358979323846;
+
+// What PI lacks of the real pi, for accurate sines near multiples of pi
+constexpr double PI_REST = 1.2246467991473532e-16;
+
+/**
+ * One vertex: position and colour (white unless the shape colours it)
+ */
+struct Vertex {
+    float x, y, z;
+    float r, g, b;
+};
+
+/**
+ * Integer position, laid out like GLint[3]
+ */
+struct Point3i {
+    int x, y, z;
+};
+
+template <class T, int N>
+struct Table {
+    T items[N];
+
+    constexpr const T& operator[](int i) const {
+        return items[i];
+    }
+    constexpr int size() const {
+        return N;
+    }
+    constexpr const T* data() const {
+        return items;
+    }
+};
+
+//- constexpr maths ---------------------------------------------------------
+
+namespace detail {
+
+    constexpr double floor(double x) {
+        return static_cast<double>(static_cast<long long>(x)) > x
+            ? static_cast<double>(static_cast<long long>(x)) - 1.0
+            : static_cast<double>(static_cast<long long>(x));
+    }
+
+    constexpr double wrap(double x, double turns) {
+        return (x - turns * 2.0 * PI) - turns * 2.0 * PI_REST;
+    }
+
+    // x in [-pi, pi]
+    constexpr double wrap(double x) {
+        return x >= -PI && x <= PI ? x : wrap(x, floor((x + PI) / (2.0 * PI)));
+    }
+
+    // Taylor series: term n is (-1)^n x^(2n+1) / (2n+1)!
+    constexpr double sin_series(double x2, double term, int n) {
+        return n > 12 ? 0.0
+            : term + sin_series(x2, -term * x2 / ((2 * n + 2) * (2 * n + 3)), n + 1);
+    }
+
+    // x in [-pi/2, pi/2]
+    constexpr double sin_reduced(double x) {
+        return sin_series(x * x, x, 0);
+    }
+
+    // x in [-pi, pi]: mirror the outer quarters into [-pi/2, pi/2]
+    constexpr double sin_wrapped(double x) {
+        return x > PI / 2 ? sin_reduced((PI - x) + PI_REST)
+             : x < -PI / 2 ? sin_reduced((-PI - x) - PI_REST)
+             : sin_reduced(x);
+    }
+
+    constexpr double sqrt_newton(double x, double guess, int steps) {
+        return steps == 0 ? guess : sqrt_newton(x, 0.5 * (guess + x / guess), steps - 1);
+    }
+
+    // Index lists built in log(N) template depth, so large tables compile
+    template <int... I>
+    struct Indices {
+    };
+
+    template <class A, class B>
+    struct Concat;
+
+    template <int... I, int... J>
+    struct Concat<Indices<I...>, Indices<J...> > {
+        typedef Indices<I..., (static_cast<int>(sizeof...(I)) + J)...> type;
+    };
+
+    template <int N>
+    struct MakeIndices {
+        typedef typename Concat<typename MakeIndices<N / 2>::type,
+                                typename MakeIndices<N - N / 2>::type>::type type;
+    };
+
+    template <>
+    struct MakeIndices<0> {
+        typedef Indices<> type;
+    };
+
+    template <>
+    struct MakeIndices<1> {
+        typedef Indices<0> type;
+    };
+
+}
+
+constexpr double sin(double x) {
+    return detail::sin_wrapped(detail::wrap(x));
+}
+
+constexpr double cos(double x) {
+    return sin((PI / 2 - x) + PI_REST / 2);
+}
+
+constexpr double sqrt(double x) {
+    return x <= 0.0 ? 0.0 : detail::sqrt_newton(x, x > 1.0 ? x : 1.0, 60);
+}
+
+// What std::sin/std::cos return for a float argument
+constexpr float sinf(float x) {
+    return static_cast<float>(sin(x));
+}
+
+constexpr float cosf(float x) {
+    return static_cast<float>(cos(x));
+}
+
+// Like a float to int assignment
+constexpr int truncate(float v) {
+    return static_cast<int>(v);
+}
+
+// Nearest integer, halves to the even one like Python's round()
+constexpr int round(double v) {
+    return v - detail::floor(v) != 0.5 ? static_cast<int>(detail::floor(v + 0.5))
+         : static_cast<int>(detail::floor(v)) % 2 == 0 ? static_cast<int>(detail::floor(v))
+         : static_cast<int>(detail::floor(v)) + 1;
+}
+
+constexpr Vertex white(float x, float y, float z) {
+    return Vertex{x, y, z, 1.0f, 1.0f, 1.0f};
+}
+
+//- Table generation --------------------------------------------------------
+
+namespace detail {
+
+    template <int N, class Shape, int... I>
+    constexpr Table<Vertex, N> generate(const Shape& shape, Indices<I...>) {
+        return Table<Vertex, N>{{shape.vertex(I)...}};
+    }
+
+    constexpr Point3i truncated(const Vertex& v) {
+        return Point3i{shapes::truncate(v.x), shapes::truncate(v.y), shapes::truncate(v.z)};
+    }
+
+    constexpr Point3i rounded(const Vertex& v) {
+        return Point3i{shapes::round(v.x), shapes::round(v.y), shapes::round(v.z)};
+    }
+
+    constexpr Point3i scaled(const Vertex& v, float scale) {
+        return Point3i{shapes::round(v.x * scale), shapes::round(v.y * scale), shapes::round(v.z * scale)};
+    }
+
+    template <int N, int... I>
+    constexpr Table<Point3i, N> truncated(const Table<Vertex, N>& table, Indices<I...>) {
+        return Table<Point3i, N>{{truncated(table[I])...}};
+    }
+
+    template <int N, int... I>
+    constexpr Table<Point3i, N> rounded(const Table<Vertex, N>& table, Indices<I...>) {
+        return Table<Point3i, N>{{rounded(table[I])...}};
+    }
+
+    template <int N, int... I>
+    constexpr Table<Point3i, N> scaled(const Table<Vertex, N>& table, float scale, Indices<I...>) {
+        return Table<Point3i, N>{{scaled(table[I], scale)...}};
+    }
+
+}
+
+/**
+ * Table of vertex(0) .. vertex(N - 1) of a shape, N normally shape.count()
+ */
+template <int N, class Shape>
+constexpr Table<Vertex, N> generate(const Shape& shape) {
+    return detail::generate<N>(shape, typename detail::MakeIndices<N>::type());
+}
+
+/**
+ * Integer positions, cut towards zero like assigning floats to GLint
+ */
+template <int N>
+constexpr Table<Point3i, N> truncated(const Table<Vertex, N>& table) {
+    return detail::truncated(table, typename detail::MakeIndices<N>::type());
+}
+
+/**
+ * Integer positions, rounded to the nearest integer
+ */
+template <int N>
+constexpr Table<Point3i, N> rounded(const Table<Vertex, N>& table) {
+    return detail::rounded(table, typename detail::MakeIndices<N>::type());
+}
+
+/**
+ * Integer positions of the table multiplied by scale, rounded
+ */
+template <int N>
+constexpr Table<Point3i, N> scaled(const Table<Vertex, N>& table, float scale) {
+    return detail::scaled(table, scale, typename detail::MakeIndices<N>::type());
+}
+
+//- Shapes ------------------------------------------------------------------
+
+/**
+ * Helix strands around the z axis, strand after strand
+ * Each strand runs from z_start to z_start + z_length in turns full turns;
+ * the strands are spread evenly around the circle.
+ */
+class Helix {
+public:
+    constexpr Helix(int points_per_strand, int strands, float radius, float turns, float z_start, float z_length)
+        : points_(points_per_strand), strands_(strands), radius_(radius), turns_(turns),
+          z_start_(z_start), z_length_(z_length) {
+    }
+
+    constexpr int count() const {
+        return points_ * strands_;
+    }
+
+    constexpr Vertex vertex(int i) const {
+        return at(static_cast<float>(i % points_) / static_cast<float>(points_ - 1), i / points_);
+    }
+
+private:
+    constexpr float angle(float t, int strand) const {
+        return static_cast<float>(t * (2.0f * turns_) * PI + 2.0 * PI * strand / strands_);
+    }
+
+    constexpr Vertex at(float t, int strand) const {
+        return white(radius_ * cosf(angle(t, strand)), radius_ * sinf(angle(t, strand)), z_start_ + z_length_ * t);
+    }
+
+    int points_, strands_;
+    float radius_, turns_, z_start_, z_length_;
+};
+
+/**
+ * Ropes wound around a cylinder (y axis), with sine modulations of the
+ * height, angle and radius so they look less static
+ * Rope points run from the top (y = height / 2) to the bottom; with
+ * several strands the ropes are interleaved point by point and spread
+ * evenly around the cylinder.
+ */
+class Rope {
+public:
+    constexpr Rope(int points_per_strand, int strands, double radius, double height, double wraps)
+        : points_(points_per_strand), strands_(strands), radius_(radius), height_(height), wraps_(wraps) {
+    }
+
+    constexpr int count() const {
+        return points_ * strands_;
+    }
+
+    constexpr Vertex vertex(int i) const {
+        return at(static_cast<double>(i / strands_) / (points_ - 1), 2.0 * PI * (i % strands_) / strands_);
+    }
+
+private:
+    constexpr double angle(double t) const {
+        return t * wraps_ * 2.0 * PI + 0.3 * sin(t * 5.0 * PI);
+    }
+
+    constexpr double radius(double t) const {
+        return radius_ + 1.0 * sin(t * 7.0 * PI);
+    }
+
+    constexpr Vertex at(double t, double phase) const {
+        return white(static_cast<float>(radius(t) * cos(angle(t) + phase) + 0.5 * sin(t * 6.0 * PI + angle(t) + phase)),
+                     static_cast<float>(height_ / 2.0 - height_ * t + 0.5 * sin(t * 8.0 * PI)),
+                     static_cast<float>(radius(t) * sin(angle(t) + phase) + 0.5 * cos(t * 6.0 * PI + angle(t) + phase)));
+    }
+
+    int points_, strands_;
+    double radius_, height_, wraps_;
+};
+
+/**
+ * Torus around the z axis with a pink/purple gradient
+ */
+class Torus {
+public:
+    constexpr Torus(int major_segments, int minor_segments, float major_radius, float minor_radius)
+        : major_(major_segments), minor_(minor_segments), major_radius_(major_radius), minor_radius_(minor_radius) {
+    }
+
+    constexpr int count() const {
+        return major_ * minor_;
+    }
+
+    constexpr Vertex vertex(int i) const {
+        return at(i / minor_, i % minor_, segment_angle(i / minor_, major_), segment_angle(i % minor_, minor_));
+    }
+
+private:
+    static constexpr float segment_angle(int i, int segments) {
+        return static_cast<float>(2.0f * PI * static_cast<float>(i) / static_cast<float>(segments));
+    }
+
+    constexpr Vertex at(int i, int j, float theta, float phi) const {
+        return Vertex{(major_radius_ + minor_radius_ * cosf(phi)) * cosf(theta),
+                      (major_radius_ + minor_radius_ * cosf(phi)) * sinf(theta),
+                      minor_radius_ * sinf(phi),
+                      0.8f + 0.2f * static_cast<float>(i) / major_,
+                      0.3f + 0.3f * static_cast<float>(j) / minor_,
+                      0.8f};
+    }
+
+    int major_, minor_;
+    float major_radius_, minor_radius_;
+};
+
+/**
+ * Star of spikes around the z axis, tilted up and down by a sine, with a
+ * rainbow gradient
+ */
+class Star {
+public:
+    constexpr Star(int spikes, int points_per_spike, float inner_radius, float outer_radius)
+        : spikes_(spikes), points_(points_per_spike), inner_(inner_radius), outer_(outer_radius) {
+    }
+
+    constexpr int count() const {
+        return spikes_ * points_;
+    }
+
+    constexpr Vertex vertex(int i) const {
+        return at(i / points_, radius(i % points_));
+    }
+
+private:
+    constexpr float radius(int j) const {
+        return inner_ + (outer_ - inner_) * (static_cast<float>(j) / static_cast<float>(points_ - 1));
+    }
+
+    constexpr double turn(int i) const {
+        return 2.0f * PI * static_cast<float>(i) / static_cast<float>(spikes_);
+    }
+
+    constexpr float phi(int i) const {
+        return static_cast<float>(PI / 4.0f * sin(turn(i)));
+    }
+
+    constexpr float hue(int i) const {
+        return static_cast<float>(i) / spikes_;
+    }
+
+    constexpr Vertex at(int i, float r) const {
+        return Vertex{r * cosf(static_cast<float>(turn(i))) * cosf(phi(i)),
+                      r * sinf(static_cast<float>(turn(i))) * cosf(phi(i)),
+                      r * sinf(phi(i)),
+                      static_cast<float>(0.5f + 0.5f * cos(hue(i) * 2.0f * PI)),
+                      static_cast<float>(0.5f + 0.5f * cos((hue(i) + 0.33f) * 2.0f * PI)),
+                      static_cast<float>(0.5f + 0.5f * cos((hue(i) + 0.67f) * 2.0f * PI))};
+    }
+
+    int spikes_, points_;
+    float inner_, outer_;
+};
+
+/**
+ * The 12 vertices of an icosahedron, (0, +-1, +-phi) and its cyclic
+ * permutations, times scale
+ */
+class Icosahedron {
+public:
+    constexpr explicit Icosahedron(float scale) : scale_(scale) {
+    }
+
+    constexpr int count() const {
+        return 12;
+    }
+
+    // Vertex order of the icosahedron demos: the y, z and x rectangles
+    constexpr Vertex vertex(int i) const {
+        return i < 4 ? white(sign(i % 2) * scale_, -sign(i / 2) * phi(), 0.0f)
+             : i < 8 ? white(0.0f, sign(i % 2) * scale_, -sign((i - 4) / 2) * phi())
+             : white(-sign((i - 8) / 2) * phi(), 0.0f, sign(i % 2) * scale_);
+    }
+
+private:
+    // 0 -> -1, 1 -> +1
+    static constexpr float sign(int bit) {
+        return bit ? 1.0f : -1.0f;
+    }
+
+    constexpr float phi() const {
+        return static_cast<float>((1.0 + sqrt(5.0)) / 2.0) * scale_;
+    }
+
+    float scale_;
+};
+
+/**
+ * Points of a cubic grid on the six faces of the cube, without the edges:
+ * side is the number of grid points along an edge, spacing their distance.
+ * Faces -x, +x, -y, +y, -z, +z, each row by row.
+ */
+class CubeGrid {
+public:
+    constexpr CubeGrid(int side, float spacing) : side_(side), spacing_(spacing) {
+    }
+
+    constexpr int count() const {
+        return 6 * (side_ - 2) * (side_ - 2);
+    }
+
+    constexpr Vertex vertex(int i) const {
+        return on_face(i / face_points(), coordinate(i % face_points() / (side_ - 2) + 1),
+                       coordinate(i % face_points() % (side_ - 2) + 1));
+    }
+
+private:
+    constexpr int face_points() const {
+        return (side_ - 2) * (side_ - 2);
+    }
+
+    // Grid index 0 .. side - 1, centred on the origin
+    constexpr float coordinate(int index) const {
+        return (index - (side_ - 1) / 2.0f) * spacing_;
+    }
+
+    constexpr Vertex on_face(int face, float u, float v) const {
+        return face / 2 == 0 ? white(face % 2 ? coordinate(side_ - 1) : coordinate(0), u, v)
+             : face / 2 == 1 ? white(u, face % 2 ? coordinate(side_ - 1) : coordinate(0), v)
+             : white(u, v, face % 2 ? coordinate(side_ - 1) : coordinate(0));
+    }
+
+    int side_;
+    float spacing_;
+};
+
+//- C64 include files --------------------------------------------------------
+
+/**
+ * Write integer vertices as an ACME include: the constant LABEL_COUNT and
+ * three tables label_x, label_y and label_z of signed bytes
+ * comment becomes the first line of the file. Returns false if a
+ * coordinate is outside -128..127 or the file could not be written.
+ */
+bool write_vertex_include(const std::string& path, const std::string& label, const std::string& comment,
+                          const Point3i* points, int count);
+
+template <int N>
+bool write_vertex_include(const std::string& path, const std::string& label, const std::string& comment,
+                          const Table<Point3i, N>& table) {
+    return write_vertex_include(path, label, comment, table.data(), N);
+}
+
+//- Objects of the demos ----------------------------------------------------
+
+// demos/cubism/part3/eval/opengl-rotating-cube-grid-cpp: 3x3 points on each face
+constexpr CubeGrid CUBE_GRID(5, 1.0f);
+
+// demos/cubism/part3/eval/opengl-rotating-cylinder-sine-cpp: two strands
+// of 16 points, two turns, radius 4, from z = -15 to 45
+constexpr Helix CYLINDER_HELIX(16, 2, 4.0f, 2.0f, -15.0f, 60.0f);
+
+// Rope around a cylinder (radius 8, height 30, 4.5 wraps), one strand of 108
+// points and the two strand version of 9 points each for the C64
+constexpr Rope CYLINDER_ROPE(108, 1, 8.0, 30.0, 4.5);
+constexpr Rope DOUBLE_ROPE(9, 2, 8.0, 30.0, 4.5);
+
+// test/opengl-morphing-models
+constexpr Torus MORPH_TORUS(16, 4, 2.0f, 0.8f);
+constexpr Star MORPH_STAR(16, 4, 1.0f, 3.5f);
+
+// test/opengl-icosahedron (GL_POINTS version, integer coordinates)
+constexpr Icosahedron ICOSAHEDRON(62.0f);
+
+}
+
+#endif
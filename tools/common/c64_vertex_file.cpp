@@ -0,0 +1,240 @@
+/*
+ * Binary vertex model files (.c64v)
+ * See c64_vertex_file.h.
+ */
+
+#include "c64_vertex_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char VERTEX_MAGIC[4] = {'C', '6', '4', 'V'};
+static const int ARRAY_COUNT = 9;
+static const int ARRAY_ALIGNMENT = 16;
+
+VertexFile::VertexFile()
+    : count(0), quantized(false), x(NULL), y(NULL), z(NULL),
+      screen_x(NULL), screen_y(NULL), screen_z(NULL), pixel_x(NULL), pixel_y(NULL), depth(NULL),
+      red(NULL), green(NULL), blue(NULL) {
+    for (int i = 0; i < 4; i++) {
+        viewport[i] = 0.0f;
+    }
+}
+
+uint16_t quantize_depth(float z) {
+    if (!(z > 0.0f)) {
+        return 0;
+    }
+    if (z >= 1.0f) {
+        return 65535;
+    }
+    return static_cast<uint16_t>(z * 65535.0f + 0.5f);
+}
+
+/**
+ * Bytes per element of each array
+ */
+static void array_sizes(bool quantized, size_t* element_size) {
+    for (int a = 0; a < ARRAY_COUNT; a++) {
+        element_size[a] = a < 3 ? sizeof(float) : a < 6 ? (quantized ? 2 : sizeof(float)) : 1;
+    }
+}
+
+/**
+ * Offsets of the arrays in the file, each aligned to 16 bytes
+ * Returns the file size.
+ */
+static size_t array_offsets(uint32_t count, bool quantized, size_t* offset) {
+    size_t element_size[ARRAY_COUNT];
+    array_sizes(quantized, element_size);
+
+    size_t position = VERTEX_FILE_HEADER_SIZE;
+    for (int a = 0; a < ARRAY_COUNT; a++) {
+        position = (position + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT;
+        offset[a] = position;
+        position += element_size[a] * count;
+    }
+    return position;
+}
+
+static void put_u16(unsigned char* p, uint32_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+}
+
+static void put_u32(unsigned char* p, uint32_t value) {
+    for (int k = 0; k < 4; k++) {
+        p[k] = (value >> (8 * k)) & 0xff;
+    }
+}
+
+static uint32_t get_u16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+/**
+ * Arrays are stored in host byte order, which must be little endian
+ */
+static bool host_is_little_endian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+bool write_vertex_file(const std::string& filename, const VertexFile& data) {
+    if (!host_is_little_endian()) {
+        return false;
+    }
+
+    const void* arrays[ARRAY_COUNT] = {
+        data.x, data.y, data.z,
+        data.quantized ? static_cast<const void*>(data.pixel_x) : data.screen_x,
+        data.quantized ? static_cast<const void*>(data.pixel_y) : data.screen_y,
+        data.quantized ? static_cast<const void*>(data.depth) : data.screen_z,
+        data.red, data.green, data.blue,
+    };
+    for (int a = 0; a < ARRAY_COUNT; a++) {
+        if (data.count > 0 && !arrays[a]) {
+            return false;
+        }
+    }
+
+    size_t element_size[ARRAY_COUNT];
+    size_t offset[ARRAY_COUNT];
+    array_sizes(data.quantized, element_size);
+    size_t file_size = array_offsets(data.count, data.quantized, offset);
+    if (file_size > 0xffffffffu) {
+        return false;
+    }
+
+    unsigned char header[VERTEX_FILE_HEADER_SIZE];
+    std::memset(header, 0, sizeof(header));
+    std::memcpy(header, VERTEX_MAGIC, 4);
+    put_u16(header + 4, VERTEX_FILE_VERSION);
+    put_u16(header + 6, data.quantized ? VERTEX_FILE_QUANTIZED : 0);
+    put_u32(header + 8, data.count);
+    put_u32(header + 12, VERTEX_FILE_HEADER_SIZE);
+    std::memcpy(header + 16, data.viewport, 4 * sizeof(float));
+    for (int a = 0; a < ARRAY_COUNT; a++) {
+        put_u32(header + 32 + 4 * a, static_cast<uint32_t>(offset[a]));
+    }
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+    size_t position = sizeof(header);
+    static const unsigned char padding[ARRAY_ALIGNMENT] = {0};
+    for (int a = 0; a < ARRAY_COUNT && ok; a++) {
+        size_t gap = offset[a] - position;
+        size_t bytes = element_size[a] * data.count;
+        ok = fwrite(padding, 1, gap, fp) == gap && fwrite(arrays[a], 1, bytes, fp) == bytes;
+        position = offset[a] + bytes;
+    }
+    return fclose(fp) == 0 && ok;
+}
+
+VertexFileReader::VertexFileReader() : map_(NULL), size_(0) {
+}
+
+VertexFileReader::~VertexFileReader() {
+    close();
+}
+
+void VertexFileReader::close() {
+    if (map_) {
+        munmap(map_, size_);
+    }
+    map_ = NULL;
+    size_ = 0;
+    file_ = VertexFile();
+}
+
+bool VertexFileReader::fail(const std::string& message) {
+    close();
+    error_ = message;
+    return false;
+}
+
+bool VertexFileReader::open(const std::string& filename) {
+    close();
+    error_.clear();
+    if (!host_is_little_endian()) {
+        return fail("big endian hosts are not supported");
+    }
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail("cannot open " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < VERTEX_FILE_HEADER_SIZE) {
+        ::close(fd);
+        return fail("file too short for a header");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* map = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        size_ = 0;
+        return fail("mmap failed");
+    }
+    map_ = map;
+
+    const unsigned char* base = static_cast<const unsigned char*>(map_);
+    if (std::memcmp(base, VERTEX_MAGIC, 4) != 0) {
+        return fail("not a vertex file");
+    }
+    if (get_u16(base + 4) != static_cast<uint32_t>(VERTEX_FILE_VERSION)) {
+        return fail("unsupported version");
+    }
+    if (get_u32(base + 12) != static_cast<uint32_t>(VERTEX_FILE_HEADER_SIZE)) {
+        return fail("unexpected header size");
+    }
+
+    VertexFile file;
+    file.quantized = (get_u16(base + 6) & VERTEX_FILE_QUANTIZED) != 0;
+    file.count = get_u32(base + 8);
+    std::memcpy(file.viewport, base + 16, 4 * sizeof(float));
+
+    // Every array must be aligned and lie completely inside the file
+    size_t element_size[ARRAY_COUNT];
+    array_sizes(file.quantized, element_size);
+    const void* arrays[ARRAY_COUNT];
+    for (int a = 0; a < ARRAY_COUNT; a++) {
+        size_t offset = get_u32(base + 32 + 4 * a);
+        if (offset < static_cast<size_t>(VERTEX_FILE_HEADER_SIZE) || offset % ARRAY_ALIGNMENT != 0 ||
+            offset > size_ || (size_ - offset) / element_size[a] < file.count) {
+            return fail("array outside of the file");
+        }
+        arrays[a] = base + offset;
+    }
+
+    file.x = static_cast<const float*>(arrays[0]);
+    file.y = static_cast<const float*>(arrays[1]);
+    file.z = static_cast<const float*>(arrays[2]);
+    if (file.quantized) {
+        file.pixel_x = static_cast<const int16_t*>(arrays[3]);
+        file.pixel_y = static_cast<const int16_t*>(arrays[4]);
+        file.depth = static_cast<const uint16_t*>(arrays[5]);
+    } else {
+        file.screen_x = static_cast<const float*>(arrays[3]);
+        file.screen_y = static_cast<const float*>(arrays[4]);
+        file.screen_z = static_cast<const float*>(arrays[5]);
+    }
+    file.red = static_cast<const unsigned char*>(arrays[6]);
+    file.green = static_cast<const unsigned char*>(arrays[7]);
+    file.blue = static_cast<const unsigned char*>(arrays[8]);
+    file_ = file;
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * Binary vertex model files (.c64v)
+ *
+ * A vertex model with projected screen coordinates, stored as a header
+ * followed by one packed array per attribute (structure of arrays). The
+ * arrays are stored exactly as they are used in memory, so a reader maps
+ * the file and points into it without parsing anything.
+ *
+ *   offset  size  field
+ *   0       4     magic "C64V"
+ *   4       2     version (1)
+ *   6       2     flags (bit 0: screen coordinates quantized)
+ *   8       4     vertex count
+ *   12      4     header size in bytes (80)
+ *   16      16    viewport x, y, width, height (float)
+ *   32      36    file offsets of the nine arrays below (uint32 each)
+ *   68      12    reserved (zero)
+ *
+ *   array  contents           type
+ *   0-2    x, y, z            float
+ *   3-5    screen x, y, z     float window coordinates like gluProject()
+ *                             (y from the bottom, z depth 0..1), or when
+ *                             quantized: int16 C64 pixel x and y (row 0
+ *                             at the top) and uint16 depth (0..65535)
+ *   6-8    red, green, blue   uint8
+ *
+ * All values are little endian. Every array starts at a multiple of 16
+ * bytes, so SSE loads and casts to typed pointers are safe.
+ */
+
+#ifndef C64_VERTEX_FILE_H
+#define C64_VERTEX_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+const int VERTEX_FILE_VERSION = 1;
+const int VERTEX_FILE_HEADER_SIZE = 80;
+const int VERTEX_FILE_QUANTIZED = 1;
+
+/**
+ * A vertex model as separate attribute arrays
+ * Used both to pass data to write_vertex_file() and to point into a
+ * mapped file. Depending on quantized, either screen_x/y/z or
+ * pixel_x/pixel_y/depth are set; the other three are NULL.
+ */
+struct VertexFile {
+    uint32_t count;
+    bool quantized;
+    float viewport[4];
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* screen_x;
+    const float* screen_y;
+    const float* screen_z;
+    const int16_t* pixel_x;
+    const int16_t* pixel_y;
+    const uint16_t* depth;
+    const unsigned char* red;
+    const unsigned char* green;
+    const unsigned char* blue;
+
+    VertexFile();
+};
+
+/**
+ * Depth 0..1 as a 16-bit value
+ */
+uint16_t quantize_depth(float z);
+
+/**
+ * Write a vertex model to a .c64v file
+ */
+bool write_vertex_file(const std::string& filename, const VertexFile& data);
+
+/**
+ * Read-only view of a .c64v file mapped into memory
+ */
+class VertexFileReader {
+public:
+    VertexFileReader();
+    ~VertexFileReader();
+
+    bool open(const std::string& filename);
+    void close();
+
+    // Valid after a successful open() until close()
+    const VertexFile& file() const {
+        return file_;
+    }
+
+    // Reason for the last failed open()
+    const std::string& error() const {
+        return error_;
+    }
+
+private:
+    // Not copyable
+    VertexFileReader(const VertexFileReader&);
+    VertexFileReader& operator=(const VertexFileReader&);
+
+    bool fail(const std::string& message);
+
+    void* map_;
+    size_t size_;
+    VertexFile file_;
+    std::string error_;
+};
+
+#endif
@@ -1,43 +1,40 @@
 /*
  * Generate Mandelbrot endless zoom animation for C64
  * Creates a 4000-frame endless zoom into the Mandelbrot set
- * Output: 320x200 pixel PNG images using Colodore palette
+ * Output: 320x200 pixel PNG images using Colodore palette, or native C64
+ *         indexed/multicolor frames
  * 
- * Compile: g++ -O3 -std=c++11 -o generate_mandelbrot_zoom generate_mandelbrot_zoom.cpp -lpng
+ * Compile: g++ -O3 -std=c++11 -pthread -ffp-contract=off -o generate_mandelbrot_zoom generate_mandelbrot_zoom.cpp \
+ *          mandelbrot_kernels.cpp mandelbrot_deepzoom.cpp mandelbrot_c64.cpp -lpng
+ * Usage:   ./generate_mandelbrot_zoom [-j N] [-e N] [--queue N] [--kernel NAME] [--no-shortcuts] [--subdivide] [--deep]
+ *                                   [--format png|raw|stream|delta] [--multicolor]
+ *                                   [--config FILE] [--frames A-B] [--resume] [--max-iter N] [--adaptive-iter] [--smooth]
+ *                                   [--aa PATTERN] [--aa-samples N] [--benchmark] [--bench-threads LIST] ...
  */
 
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <png.h>
 
-// Colodore palette - a more accurate C64 color palette
-// Based on Colodore palette by Pepto: https://www.colodore.com/
-struct RGB {
-    unsigned char r, g, b;
-};
-
-const RGB COLODORE_PALETTE_RGB[16] = {
-    {0x00, 0x00, 0x00},  // 0: Black
-    {0xFF, 0xFF, 0xFF},  // 1: White
-    {0x81, 0x33, 0x38},  // 2: Red
-    {0x75, 0xCE, 0xC8},  // 3: Cyan
-    {0x8E, 0x3C, 0x97},  // 4: Purple
-    {0x56, 0xAC, 0x4D},  // 5: Green
-    {0x2E, 0x2C, 0x9B},  // 6: Blue
-    {0xED, 0xF1, 0x71},  // 7: Yellow
-    {0x8E, 0x50, 0x29},  // 8: Orange
-    {0x55, 0x38, 0x00},  // 9: Brown
-    {0xC4, 0x6C, 0x71},  // 10: Light Red
-    {0x4A, 0x4A, 0x4A},  // 11: Dark Grey
-    {0x7B, 0x7B, 0x7B},  // 12: Medium Grey
-    {0xA9, 0xFF, 0x9F},  // 13: Light Green
-    {0x70, 0x6D, 0xEB},  // 14: Light Blue
-    {0xB2, 0xB2, 0xB2},  // 15: Light Grey
-};
+#include "mandelbrot_kernels.h"
+#include "mandelbrot_deepzoom.h"
+#include "mandelbrot_c64.h"
+#include "ring_buffer.h"
 
 // Create a palette for Mandelbrot rendering
 // Smooth gradient from dark to light
@@ -51,54 +48,157 @@ const int MANDELBROT_PALETTE[7] = {
     0x0d,  // Light Green
 };
 
-// Animation parameters
-const int WIDTH = 320;        // pixels
-const int HEIGHT = 200;       // pixels
-const int FRAMES = 4000;      // number of animation frames
-const int MAX_ITER = 256;     // maximum iterations for Mandelbrot calculation
+/**
+ * Animation parameters of a render job
+ * The defaults are the classic 4000-frame seahorse valley zoom; every value
+ * can be set on the command line or in a job file (--config).
+ */
+struct JobConfig {
+    int width;              // pixels
+    int height;             // pixels
+    int frames;             // number of animation frames
+    int max_iter;           // maximum iterations for Mandelbrot calculation
+    double zoom_factor;     // zoom factor per frame (smaller = slower zoom)
+    double center_x;        // point in the Mandelbrot set to zoom into
+    double center_y;
+    int first_frame;        // frame range rendered by this job (--frames A-B)
+    int last_frame;
+};
+
+static JobConfig g_config = {
+    320, 200,               // C64 hi-res resolution
+    4000,
+    256,
+    1.02,
+    -0.743643887037151,     // classic zoom target near the "seahorse valley"
+    0.131825904205330,
+    0, 3999,
+};
+
+// Deep zoom: frames with a pixel spacing below this are rendered with
+// perturbation theory, since double coordinates can no longer resolve them
+const double DEEP_ZOOM_PIXEL_SPACING = 1e-12;
+
+// Escape-time kernel used by generate_frame(), selected at startup
+static const KernelInfo* g_kernel = NULL;
+
+// Interior and periodicity shortcuts in the kernels (--no-shortcuts disables)
+static bool g_shortcuts = true;
+
+// Render deep frames with perturbation theory (--deep)
+static bool g_deep_zoom = false;
+
+// Rectangle subdivision (--subdivide): tiles with a uniform border are
+// filled without iterating; tiles below the minimum size are computed
+// directly. Subdivision starts from a grid of tiles, since a large
+// rectangle whose border lies in one escape band can still enclose
+// part of the set.
+static bool g_subdivide = false;
+const int SUBDIVIDE_MIN_SIZE = 6;
+const int SUBDIVIDE_TILE_SIZE = 32;
+
+// Keyframe reuse (--reuse): keyframes are rendered oversampled and the
+// following frames are resampled from them until the keyframe samples
+// become coarser than g_reuse_threshold output pixels
+static bool g_reuse = false;
+static int g_reuse_oversample = 2;
+static double g_reuse_threshold = 1.0;
+
+// Output format (--format): RGB PNG files, packed 4-bit raw files,
+// all frames in one stream file, or a delta stream of the changes between
+// frames. Raw and stream output keep the palette indices and skip the RGB
+// expansion.
+enum OutputFormat {
+    FORMAT_PNG,
+    FORMAT_RAW,
+    FORMAT_STREAM,
+    FORMAT_DELTA,
+};
+static OutputFormat g_format = FORMAT_PNG;
 
-// Zoom animation parameters
-const double ZOOM_FACTOR = 1.02;  // Zoom factor per frame (smaller = slower zoom)
-// Interesting point in the Mandelbrot set to zoom into
-// This is a classic zoom target near the "seahorse valley"
-const double CENTER_X = -0.743643887037151;
-const double CENTER_Y = 0.131825904205330;
+// C64 multicolor bitmap layout for raw and stream output (--multicolor)
+static bool g_multicolor = false;
+
+// Adaptive iteration budget (--adaptive-iter): every frame gets its own
+// budget from its zoom depth and the escape histogram of a coarse probe
+// render of the frame; --max-iter becomes the upper limit
+static bool g_adaptive_iter = false;
+const int ADAPTIVE_MIN_ITER = 64;
+const double ADAPTIVE_ITER_PER_DECADE = 32.0;   // depth floor per 10x zoom
+const int ADAPTIVE_PROBE_WIDTH = 40;
+const int ADAPTIVE_PROBE_HEIGHT = 25;
+const double ADAPTIVE_PERCENTILE = 0.995;       // of escaped probe points
+const double ADAPTIVE_HEADROOM = 1.5;
+
+// Smooth coloring (--smooth): normalized iteration count from |z| at escape
+static bool g_smooth = false;
+
+// Edge-only anti-aliasing (--aa PATTERN): pixels with a differently
+// colored neighbour get --aa-samples extra samples in an n x n pattern and
+// take the most common color
+enum AAPattern {
+    AA_OFF,
+    AA_GRID,        // regular grid
+    AA_RGSS,        // rotated grid, one sample per row and column
+    AA_JITTER       // one random position per grid cell
+};
+static AAPattern g_aa = AA_OFF;
+static int g_aa_samples = 4;
+const int AA_MAX_GRID = 8;          // up to 8x8 samples
+const int AA_BATCH_SAMPLES = 4096;  // samples per kernel call
+
+// Benchmark mode (--benchmark): representative frames of the zoom,
+// rendered with every kernel and thread count
+struct BenchmarkCase {
+    const char* name;
+    int frame;
+};
+const BenchmarkCase BENCHMARK_CASES[] = {
+    {"shallow", 0},         // whole set, mostly fast escapes
+    {"seahorse", 600},      // seahorse valley spirals, long orbits
+    {"deep", 1500},         // beyond double precision (perturbation)
+    {NULL, 0}
+};
+const int BENCHMARK_FRAMES = 8;     // consecutive frames per case
+const char* BENCHMARK_JSON_FILENAME = "mandelbrot_benchmark.json";
+const char* BENCHMARK_CSV_FILENAME = "mandelbrot_benchmark.csv";
+const char* BENCHMARK_PNG_SINK = "/dev/null";
+
+const char* STREAM_FILENAME = "mandelbrot_zoom.c64z";
+const char* DELTA_FILENAME = "mandelbrot_zoom.c64d";
+const char* DELTA_REPORT_FILENAME = "mandelbrot_zoom_delta.csv";
+const char* JOB_FILENAME = "job.cfg";
 
 /**
- * Calculate Mandelbrot set membership
- * Returns number of iterations before escape (or max_iter if it doesn't escape)
+ * Per-frame render statistics
  */
-int mandelbrot(double c_real, double c_imag, int max_iter) {
-    double z_real = 0.0;
-    double z_imag = 0.0;
-    
-    for (int i = 0; i < max_iter; i++) {
-        // Check if we've escaped (|z| > 2)
-        if (z_real * z_real + z_imag * z_imag > 4.0) {
-            return i;
-        }
-        
-        // z = z^2 + c
-        double z_real_new = z_real * z_real - z_imag * z_imag + c_real;
-        z_imag = 2.0 * z_real * z_imag + c_imag;
-        z_real = z_real_new;
-    }
-    
-    return max_iter;
-}
+struct FrameStats {
+    bool deep;              // rendered with perturbation theory
+    long long samples;      // points iterated (0 for resampled frames)
+    long long skipped;      // pixels filled by rectangle subdivision
+    KernelStats kernel;     // iterations performed and saved by shortcuts
+    long long rebases;      // perturbation orbit rebases
+    long long glitches;     // glitched pixels detected (and corrected by rebasing)
+    int max_iter;           // iteration budget of the frame
+    long long pixels;       // pixels of the rendered view
+    long long aa_pixels;    // edge pixels supersampled by anti-aliasing
+};
 
 /**
  * Convert iteration count to palette color index
- * Uses smooth coloring for better gradients
+ * Uses smooth coloring for better gradients: the normalized iteration count
+ * n + 1 - log2(log|z_n|) needs |z_n|^2 at escape (norm). Without it
+ * (norm 0) |z_n| = 2 is assumed, the lower limit at escape.
  */
-int iteration_to_color(int iteration, int max_iter) {
+int iteration_to_color(int iteration, double norm, int max_iter) {
     if (iteration == max_iter) {
         return MANDELBROT_PALETTE[0];  // First palette color for points in the set
     }
     
     // Smooth coloring with logarithmic mapping
     // This creates nice smooth color gradients
-    double smooth_iter = iteration + 1 - std::log(std::log(2.0)) / std::log(2.0);
+    double log_z = norm > 4.0 ? 0.5 * std::log(norm) : std::log(2.0);
+    double smooth_iter = iteration + 1 - std::log(log_z) / std::log(2.0);
     
     // Map to palette (cycling through colors)
     int palette_index = static_cast<int>(smooth_iter * 2) % 7;
@@ -168,44 +268,551 @@ bool save_png(const std::string& filename, unsigned char* image_data, int width,
 }
 
 /**
- * Generate one frame of the Mandelbrot zoom animation
+ * Save raw bytes to a file
  */
-void generate_frame(int frame_num, unsigned char* image_data) {
+bool save_raw(const std::string& filename, const unsigned char* data, int size) {
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (!fp) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    
+    bool ok = fwrite(data, 1, size, fp) == static_cast<size_t>(size);
+    return fclose(fp) == 0 && ok;
+}
+
+/**
+ * Size of the complex plane window (vertical half-extent) for a frame
+ */
+double frame_scale(int frame_num) {
     // Calculate zoom level for this frame
-    double zoom = std::pow(ZOOM_FACTOR, frame_num);
+    double zoom = std::pow(g_config.zoom_factor, frame_num);
     
-    // Calculate the scale (size of the complex plane window)
     // Start with a view that shows the full Mandelbrot set
     double initial_scale = 3.0;
-    double scale = initial_scale / zoom;
-    
-    // Render Mandelbrot set
-    for (int py = 0; py < HEIGHT; py++) {
-        for (int px = 0; px < WIDTH; px++) {
-            // Map pixel coordinates to complex plane
-            // Center the zoom on our target point
-            double x_ratio = (px - WIDTH / 2.0) / (WIDTH / 2.0);
-            double y_ratio = (py - HEIGHT / 2.0) / (HEIGHT / 2.0);
-            
-            double c_real = CENTER_X + x_ratio * scale * (static_cast<double>(WIDTH) / HEIGHT);
-            double c_imag = CENTER_Y + y_ratio * scale;
-            
-            // Calculate Mandelbrot iteration
-            int iteration = mandelbrot(c_real, c_imag, MAX_ITER);
-            
-            // Convert to color
-            int color_index = iteration_to_color(iteration, MAX_ITER);
-            RGB rgb = COLODORE_PALETTE_RGB[color_index];
-            
-            // Set pixel color (RGB format)
-            int pixel_idx = (py * WIDTH + px) * 3;
-            image_data[pixel_idx + 0] = rgb.r;
-            image_data[pixel_idx + 1] = rgb.g;
-            image_data[pixel_idx + 2] = rgb.b;
+    return initial_scale / zoom;
+}
+
+/**
+ * Sampling grid of one frame view
+ * c depends only on the column (real part) and the row (imaginary part),
+ * so both are precomputed once per view. For deep frames the values are
+ * offsets from the reference orbit at the zoom center.
+ */
+struct FrameView {
+    int width;
+    int height;
+    int max_iter;
+    bool deep;
+    double pixel_real;              // sample spacing
+    double pixel_imag;
+    std::vector<double> c_real;     // per column
+    std::vector<double> c_imag;     // per row
+    ReferenceOrbit ref;
+};
+
+/**
+ * Set up the sampling grid for the view of a frame
+ * The view is sampled on a width x height grid; at the output
+ * resolution every sample sits on an output pixel, larger grids
+ * oversample the same window (used for keyframes).
+ */
+void setup_view(int frame_num, int width, int height, int max_iter, FrameView* view) {
+    double scale = frame_scale(frame_num);
+    
+    view->width = width;
+    view->height = height;
+    view->max_iter = max_iter;
+    
+    // Deep frames iterate offsets against a high precision reference orbit
+    view->deep = g_deep_zoom && scale / (height / 2.0) < DEEP_ZOOM_PIXEL_SPACING;
+    if (view->deep) {
+        view->ref.compute(BigFixed(g_config.center_x), BigFixed(g_config.center_y), max_iter);
+    }
+    
+    // Map pixel coordinates to complex plane
+    // Center the zoom on our target point
+    view->pixel_real = scale * (static_cast<double>(g_config.width) / g_config.height) / (width / 2.0);
+    view->pixel_imag = scale / (height / 2.0);
+    view->c_real.resize(width);
+    for (int px = 0; px < width; px++) {
+        double x_ratio = (px - width / 2.0) / (width / 2.0);
+        view->c_real[px] = x_ratio * scale * (static_cast<double>(g_config.width) / g_config.height);
+        if (!view->deep) {
+            view->c_real[px] = g_config.center_x + view->c_real[px];
+        }
+    }
+    
+    view->c_imag.resize(height);
+    for (int py = 0; py < height; py++) {
+        double y_ratio = (py - height / 2.0) / (height / 2.0);
+        view->c_imag[py] = y_ratio * scale;
+        if (!view->deep) {
+            view->c_imag[py] = g_config.center_y + view->c_imag[py];
+        }
+    }
+}
+
+/**
+ * Calculate iterations for a list of points of a view
+ * c_real/c_imag hold the coordinates as set up by setup_view(). norms
+ * receives |z|^2 at escape for smooth coloring and may be NULL.
+ */
+void compute_points(const FrameView& view, const double* c_real, const double* c_imag,
+                    int count, int* iterations, float* norms, FrameStats* stats) {
+    if (view.deep) {
+        PerturbationStats perturbation = {0, 0};
+        float norm;
+        for (int i = 0; i < count; i++) {
+            iterations[i] = mandelbrot_perturbed(view.ref, c_real[i], c_imag[i], view.max_iter,
+                                                 norms ? norms + i : &norm, &perturbation);
+            stats->kernel.iterations += iterations[i];
+        }
+        stats->rebases += perturbation.rebases;
+        stats->glitches += perturbation.glitches;
+    } else {
+        g_kernel->kernel(c_real, c_imag, count, view.max_iter, g_shortcuts, iterations, norms, &stats->kernel);
+    }
+    stats->samples += count;
+}
+
+/**
+ * Rectangle subdivision (Mariani-Silver) state for one view
+ * Unknown pixels hold -1; border pixels are computed in batches.
+ */
+struct Subdivision {
+    const FrameView* view;
+    int* iterations;
+    float* norms;           // NULL without smooth coloring
+    FrameStats* stats;
+    std::vector<double> c_real;
+    std::vector<double> c_imag;
+    std::vector<int> index;
+    std::vector<int> result;
+    std::vector<float> result_norms;
+};
+
+/**
+ * Compute all still unknown pixels of a rectangle's border (edges only)
+ * or of the whole rectangle (edges_only == false)
+ */
+void subdivide_compute(Subdivision* sub, int x0, int y0, int x1, int y1, bool edges_only) {
+    const FrameView& view = *sub->view;
+    sub->c_real.clear();
+    sub->c_imag.clear();
+    sub->index.clear();
+    
+    for (int y = y0; y <= y1; y++) {
+        bool edge_row = y == y0 || y == y1;
+        int step = (edges_only && !edge_row) ? x1 - x0 : 1;
+        for (int x = x0; x <= x1; x += (step > 0 ? step : 1)) {
+            int i = y * view.width + x;
+            if (sub->iterations[i] < 0) {
+                sub->c_real.push_back(view.c_real[x]);
+                sub->c_imag.push_back(view.c_imag[y]);
+                sub->index.push_back(i);
+            }
+        }
+    }
+    
+    int count = static_cast<int>(sub->index.size());
+    if (count == 0) {
+        return;
+    }
+    sub->result.resize(count);
+    sub->result_norms.resize(count);
+    compute_points(view, sub->c_real.data(), sub->c_imag.data(), count, sub->result.data(),
+                   sub->norms ? sub->result_norms.data() : NULL, sub->stats);
+    for (int k = 0; k < count; k++) {
+        sub->iterations[sub->index[k]] = sub->result[k];
+    }
+    if (sub->norms) {
+        for (int k = 0; k < count; k++) {
+            sub->norms[sub->index[k]] = sub->result_norms[k];
+        }
+    }
+}
+
+/**
+ * Whether border pixel i matches the corner: the same iteration count and,
+ * with smooth coloring, the same color (one iteration spans two palette
+ * entries there, so equal counts alone would fill across a color edge)
+ */
+bool subdivide_matches(const Subdivision* sub, int i, int value, int color) {
+    if (sub->iterations[i] != value) {
+        return false;
+    }
+    return !sub->norms || iteration_to_color(value, sub->norms[i], sub->view->max_iter) == color;
+}
+
+/**
+ * Mariani-Silver: if the whole border of a rectangle has the same
+ * iteration count (and color), the interior is filled with it without
+ * iterating; otherwise the rectangle is split in half and both halves recurse
+ */
+void subdivide_rect(Subdivision* sub, int x0, int y0, int x1, int y1) {
+    const int width = sub->view->width;
+    int* it = sub->iterations;
+    
+    // Small rectangles are cheaper to compute than to subdivide further
+    if (x1 - x0 < SUBDIVIDE_MIN_SIZE || y1 - y0 < SUBDIVIDE_MIN_SIZE) {
+        subdivide_compute(sub, x0, y0, x1, y1, false);
+        return;
+    }
+    
+    subdivide_compute(sub, x0, y0, x1, y1, true);
+    
+    int value = it[y0 * width + x0];
+    int color = sub->norms ? iteration_to_color(value, sub->norms[y0 * width + x0], sub->view->max_iter) : 0;
+    bool uniform = true;
+    for (int x = x0; x <= x1 && uniform; x++) {
+        uniform = subdivide_matches(sub, y0 * width + x, value, color) &&
+                  subdivide_matches(sub, y1 * width + x, value, color);
+    }
+    for (int y = y0; y <= y1 && uniform; y++) {
+        uniform = subdivide_matches(sub, y * width + x0, value, color) &&
+                  subdivide_matches(sub, y * width + x1, value, color);
+    }
+    
+    if (uniform) {
+        for (int y = y0 + 1; y < y1; y++) {
+            for (int x = x0 + 1; x < x1; x++) {
+                it[y * width + x] = value;
+            }
+        }
+        if (sub->norms) {
+            // Filled pixels take the escape magnitude of the corner
+            float norm = sub->norms[y0 * width + x0];
+            for (int y = y0 + 1; y < y1; y++) {
+                std::fill(sub->norms + y * width + x0 + 1, sub->norms + y * width + x1, norm);
+            }
+        }
+        sub->stats->skipped += static_cast<long long>(x1 - x0 - 1) * (y1 - y0 - 1);
+        return;
+    }
+    
+    // Split along the longer side; both halves share the split line
+    if (x1 - x0 >= y1 - y0) {
+        int mid = (x0 + x1) / 2;
+        subdivide_rect(sub, x0, y0, mid, y1);
+        subdivide_rect(sub, mid, y0, x1, y1);
+    } else {
+        int mid = (y0 + y1) / 2;
+        subdivide_rect(sub, x0, y0, x1, mid);
+        subdivide_rect(sub, x0, mid, x1, y1);
+    }
+}
+
+/**
+ * Iteration budget of a frame
+ * With --adaptive-iter a coarse probe of the frame is iterated up to
+ * --max-iter. The budget covers the slowest escaping probe points (the
+ * ADAPTIVE_PERCENTILE of escape iterations, plus headroom), but never
+ * drops below a floor growing with the zoom depth, since the probe can
+ * miss thin filaments. The probe only depends on the frame number, so
+ * budgets are the same for any thread count or frame range.
+ */
+int frame_budget(int frame_num, FrameStats* stats) {
+    if (!g_adaptive_iter) {
+        return g_config.max_iter;
+    }
+    const int cap = g_config.max_iter;
+    
+    FrameView probe;
+    setup_view(frame_num, ADAPTIVE_PROBE_WIDTH, ADAPTIVE_PROBE_HEIGHT, cap, &probe);
+    std::vector<int> iterations(ADAPTIVE_PROBE_WIDTH * ADAPTIVE_PROBE_HEIGHT);
+    std::vector<double> c_imag(ADAPTIVE_PROBE_WIDTH);
+    for (int py = 0; py < ADAPTIVE_PROBE_HEIGHT; py++) {
+        std::fill(c_imag.begin(), c_imag.end(), probe.c_imag[py]);
+        compute_points(probe, probe.c_real.data(), c_imag.data(), ADAPTIVE_PROBE_WIDTH,
+                       iterations.data() + py * ADAPTIVE_PROBE_WIDTH, NULL, stats);
+    }
+    
+    // Escape histogram of the probe; points at the cap count as interior
+    std::vector<int> histogram(cap, 0);
+    int escaped = 0;
+    for (size_t i = 0; i < iterations.size(); i++) {
+        if (iterations[i] < cap) {
+            histogram[iterations[i]]++;
+            escaped++;
+        }
+    }
+    int slowest = 0;
+    int target = static_cast<int>(std::ceil(escaped * ADAPTIVE_PERCENTILE));
+    for (int n = 0, seen = 0; n < cap && seen < target; n++) {
+        seen += histogram[n];
+        slowest = n;
+    }
+    
+    double depth = std::log10(3.0 / frame_scale(frame_num));
+    int budget = std::max(static_cast<int>(std::ceil(slowest * ADAPTIVE_HEADROOM)),
+                          ADAPTIVE_MIN_ITER + static_cast<int>(ADAPTIVE_ITER_PER_DECADE * depth));
+    return std::min(std::max(budget, ADAPTIVE_MIN_ITER), cap);
+}
+
+/**
+ * Side length n of the n x n anti-aliasing pattern
+ */
+int aa_grid_size() {
+    return static_cast<int>(std::sqrt(static_cast<double>(g_aa_samples)) + 0.5);
+}
+
+/**
+ * Offset of anti-aliasing sample k of pixel (px, py) from the pixel
+ * center, in pixels
+ * Sample k lies in cell (k % n, k / n) of an n x n grid over the pixel.
+ * Jittered positions are hashed from the pixel position and not the frame,
+ * so the pattern stays the same over the whole zoom instead of flickering.
+ */
+void aa_offset(int px, int py, int k, double* ox, double* oy) {
+    const int n = aa_grid_size();
+    int i = k % n;
+    int j = k / n;
+    double x, y;
+    if (g_aa == AA_RGSS) {
+        // Column i * n + j and row j * n + (n - 1 - i) of the n^2 x n^2 grid
+        x = (i + (j + 0.5) / n) / n;
+        y = (j + (n - 1 - i + 0.5) / n) / n;
+    } else if (g_aa == AA_JITTER) {
+        uint32_t h = static_cast<uint32_t>(px) * 0x9e3779b1u ^ static_cast<uint32_t>(py) * 0x85ebca77u ^
+                     static_cast<uint32_t>(k) * 0xc2b2ae3du;
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        x = (i + (h & 0xffff) / 65536.0) / n;
+        y = (j + (h >> 16) / 65536.0) / n;
+    } else {
+        x = (i + 0.5) / n;
+        y = (j + 0.5) / n;
+    }
+    *ox = x - 0.5;
+    *oy = y - 0.5;
+}
+
+/**
+ * Supersample the edge pixels of a computed view
+ * A pixel is an edge pixel if one of its four neighbours has a different
+ * palette color. Its center sample and the pattern samples vote on the
+ * color; the pixel takes the iteration count of the first sample of the
+ * winning color (the center sample on a tie). Uniform areas are not
+ * touched, so the cost follows the amount of detail in the frame.
+ */
+void antialias_view(const FrameView& view, int* iterations, float* norms, FrameStats* stats) {
+    const int width = view.width;
+    const int height = view.height;
+    
+    std::vector<unsigned char> colors(width * height);
+    for (int i = 0; i < width * height; i++) {
+        colors[i] = static_cast<unsigned char>(iteration_to_color(iterations[i], norms ? norms[i] : 0.0, view.max_iter));
+    }
+    std::vector<int> edges;
+    for (int py = 0; py < height; py++) {
+        for (int px = 0; px < width; px++) {
+            int i = py * width + px;
+            unsigned char c = colors[i];
+            if ((px > 0 && colors[i - 1] != c) || (px < width - 1 && colors[i + 1] != c) ||
+                (py > 0 && colors[i - width] != c) || (py < height - 1 && colors[i + width] != c)) {
+                edges.push_back(i);
+            }
+        }
+    }
+    stats->aa_pixels += edges.size();
+    
+    const int samples = g_aa_samples;
+    const int batch_pixels = std::max(1, AA_BATCH_SAMPLES / samples);
+    std::vector<double> c_real(batch_pixels * samples);
+    std::vector<double> c_imag(batch_pixels * samples);
+    std::vector<int> result(batch_pixels * samples);
+    std::vector<float> result_norms(norms ? batch_pixels * samples : 0);
+    for (size_t first = 0; first < edges.size(); first += batch_pixels) {
+        int count = static_cast<int>(std::min(edges.size() - first, static_cast<size_t>(batch_pixels)));
+        for (int e = 0; e < count; e++) {
+            int px = edges[first + e] % width;
+            int py = edges[first + e] / width;
+            for (int k = 0; k < samples; k++) {
+                double ox, oy;
+                aa_offset(px, py, k, &ox, &oy);
+                c_real[e * samples + k] = view.c_real[px] + ox * view.pixel_real;
+                c_imag[e * samples + k] = view.c_imag[py] + oy * view.pixel_imag;
+            }
+        }
+        compute_points(view, c_real.data(), c_imag.data(), count * samples, result.data(),
+                       norms ? result_norms.data() : NULL, stats);
+        
+        for (int e = 0; e < count; e++) {
+            int i = edges[first + e];
+            const int* sample_it = result.data() + e * samples;
+            const float* sample_norms = norms ? result_norms.data() + e * samples : NULL;
+            unsigned char sample_colors[AA_MAX_GRID * AA_MAX_GRID];
+            int votes[16] = {0};
+            votes[colors[i]]++;
+            for (int k = 0; k < samples; k++) {
+                sample_colors[k] = static_cast<unsigned char>(
+                    iteration_to_color(sample_it[k], sample_norms ? sample_norms[k] : 0.0, view.max_iter));
+                votes[sample_colors[k]]++;
+            }
+            int winner = colors[i];
+            for (int c = 0; c < 16; c++) {
+                if (votes[c] > votes[winner]) {
+                    winner = c;
+                }
+            }
+            if (winner == colors[i]) {
+                continue;
+            }
+            for (int k = 0; k < samples; k++) {
+                if (sample_colors[k] == winner) {
+                    iterations[i] = sample_it[k];
+                    if (norms) {
+                        norms[i] = sample_norms[k];
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Calculate iteration counts for the view of one frame
+ * See setup_view() for the meaning of the width x height grid.
+ * norms receives |z|^2 at escape for smooth coloring and may be NULL.
+ */
+void compute_iterations(int frame_num, int width, int height, int* iterations, float* norms,
+                        FrameStats* stats) {
+    stats->max_iter = frame_budget(frame_num, stats);
+    
+    FrameView view;
+    setup_view(frame_num, width, height, stats->max_iter, &view);
+    stats->deep = view.deep;
+    
+    if (g_subdivide) {
+        Subdivision sub;
+        sub.view = &view;
+        sub.iterations = iterations;
+        sub.norms = norms;
+        sub.stats = stats;
+        std::fill(iterations, iterations + width * height, -1);
+        for (int y0 = 0; y0 < height - 1; y0 += SUBDIVIDE_TILE_SIZE) {
+            for (int x0 = 0; x0 < width - 1; x0 += SUBDIVIDE_TILE_SIZE) {
+                int x1 = std::min(x0 + SUBDIVIDE_TILE_SIZE, width - 1);
+                int y1 = std::min(y0 + SUBDIVIDE_TILE_SIZE, height - 1);
+                subdivide_rect(&sub, x0, y0, x1, y1);
+            }
+        }
+    } else {
+        // Render Mandelbrot set row by row
+        std::vector<double> c_imag(width);
+        for (int py = 0; py < height; py++) {
+            std::fill(c_imag.begin(), c_imag.end(), view.c_imag[py]);
+            compute_points(view, view.c_real.data(), c_imag.data(), width, iterations + py * width,
+                           norms ? norms + py * width : NULL, stats);
+        }
+    }
+    
+    stats->pixels += static_cast<long long>(width) * height;
+    if (g_aa != AA_OFF) {
+        antialias_view(view, iterations, norms, stats);
+    }
+}
+
+/**
+ * Convert a frame of iteration counts (and escape magnitudes, if not NULL)
+ * to RGB pixels
+ */
+void colorize_frame(const int* iterations, const float* norms, int max_iter, unsigned char* image_data) {
+    for (int i = 0; i < g_config.width * g_config.height; i++) {
+        // Convert to color
+        int color_index = iteration_to_color(iterations[i], norms ? norms[i] : 0.0, max_iter);
+        RGB rgb = COLODORE_PALETTE_RGB[color_index];
+        
+        // Set pixel color (RGB format)
+        image_data[i * 3 + 0] = rgb.r;
+        image_data[i * 3 + 1] = rgb.g;
+        image_data[i * 3 + 2] = rgb.b;
+    }
+}
+
+/**
+ * Convert a frame of iteration counts to palette indices
+ */
+void index_frame(const int* iterations, const float* norms, int max_iter, unsigned char* indices) {
+    for (int i = 0; i < g_config.width * g_config.height; i++) {
+        indices[i] = static_cast<unsigned char>(iteration_to_color(iterations[i], norms ? norms[i] : 0.0, max_iter));
+    }
+}
+
+/**
+ * Convert iteration counts to the pixel data of the output format:
+ * RGB for PNG output, palette indices otherwise
+ */
+void shade_frame(const int* iterations, const float* norms, int max_iter, unsigned char* pixels) {
+    if (g_format == FORMAT_PNG) {
+        colorize_frame(iterations, norms, max_iter, pixels);
+    } else {
+        index_frame(iterations, norms, max_iter, pixels);
+    }
+}
+
+/**
+ * Bytes per pixel of the frame buffers handed to the encoders
+ */
+int pixel_size() {
+    return g_format == FORMAT_PNG ? 3 : 1;
+}
+
+/**
+ * Resample a frame from the oversampled iteration buffer of a keyframe
+ * Frame pixels are mapped into the (smaller scale) keyframe window and take
+ * the iteration count (and escape magnitude) of the nearest keyframe
+ * sample. Since the zoom center is fixed, later frames always lie inside
+ * the keyframe window.
+ */
+void resample_keyframe(const std::vector<int>& keyframe, const std::vector<float>& keyframe_norms,
+                       int key_frame_num, int frame_num, int* iterations, float* norms) {
+    const int key_width = g_config.width * g_reuse_oversample;
+    const int key_height = g_config.height * g_reuse_oversample;
+    double ratio = frame_scale(frame_num) / frame_scale(key_frame_num);
+    
+    // Nearest keyframe column for every frame column
+    std::vector<int> key_x(g_config.width);
+    for (int px = 0; px < g_config.width; px++) {
+        double x_ratio = (px - g_config.width / 2.0) / (g_config.width / 2.0);
+        int kx = static_cast<int>(std::floor(x_ratio * ratio * (key_width / 2.0) + key_width / 2.0 + 0.5));
+        key_x[px] = std::min(std::max(kx, 0), key_width - 1);
+    }
+    
+    for (int py = 0; py < g_config.height; py++) {
+        double y_ratio = (py - g_config.height / 2.0) / (g_config.height / 2.0);
+        int ky = static_cast<int>(std::floor(y_ratio * ratio * (key_height / 2.0) + key_height / 2.0 + 0.5));
+        ky = std::min(std::max(ky, 0), key_height - 1);
+        
+        const int* key_row = keyframe.data() + ky * key_width;
+        for (int px = 0; px < g_config.width; px++) {
+            iterations[py * g_config.width + px] = key_row[key_x[px]];
+        }
+        if (norms) {
+            const float* key_norms = keyframe_norms.data() + ky * key_width;
+            for (int px = 0; px < g_config.width; px++) {
+                norms[py * g_config.width + px] = key_norms[key_x[px]];
+            }
         }
     }
 }
 
+/**
+ * Number of frames that can be resampled from one keyframe
+ * A keyframe oversampled by F stays usable while its sample spacing is at
+ * most threshold times the output pixel spacing, i.e. for
+ * zoom_factor^n <= F * threshold.
+ */
+int reuse_segment_length() {
+    int length = static_cast<int>(std::floor(std::log(g_reuse_oversample * g_reuse_threshold) / std::log(g_config.zoom_factor) + 1e-9)) + 1;
+    return std::max(length, 1);
+}
+
 /**
  * Check if directory exists, create if not
  */
@@ -219,54 +826,1308 @@ bool ensure_directory(const std::string& path) {
     return mkdir(path.c_str(), 0755) == 0;
 }
 
-int main() {
-    std::cout << "Generating Mandelbrot endless zoom animation..." << std::endl;
-    std::cout << "  Resolution: " << WIDTH << "x" << HEIGHT << " pixels" << std::endl;
-    std::cout << "  Frames: " << FRAMES << std::endl;
-    std::cout << "  Zoom center: (" << CENTER_X << ", " << CENTER_Y << ")" << std::endl;
-    std::cout << "  Zoom factor per frame: " << ZOOM_FACTOR << std::endl;
-    std::cout << "  Final zoom level: " << std::scientific << std::pow(ZOOM_FACTOR, FRAMES) << "x" << std::endl;
-    
-    // Create output directory for PNG frames
-    std::string frames_dir = "frames";
-    if (!ensure_directory(frames_dir)) {
-        std::cerr << "Error: Could not create directory: " << frames_dir << std::endl;
-        return 1;
+/**
+ * Check whether the output format writes one file per frame
+ * Only those can be sharded into separate processes and resumed.
+ */
+bool frame_files() {
+    return g_format == FORMAT_PNG || g_format == FORMAT_RAW;
+}
+
+/**
+ * File name of a frame for the per-frame output formats
+ */
+std::string frame_filename(const std::string& frames_dir, int frame) {
+    std::ostringstream filename;
+    filename << frames_dir << "/frame_" << std::setfill('0') << std::setw(4) << frame;
+    if (g_format == FORMAT_PNG) {
+        filename << ".png";
+    } else if (g_multicolor) {
+        filename << ".kla";
+    } else {
+        filename << ".raw";
+    }
+    return filename.str();
+}
+
+/**
+ * Read a big endian 32-bit value
+ */
+unsigned int read_be32(const unsigned char* p) {
+    return (static_cast<unsigned int>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * Check whether a frame file from an earlier run is complete
+ * PNG files need the signature, an IHDR chunk with the job resolution and
+ * a final IEND chunk; raw and Koala files need their exact size.
+ */
+bool frame_file_valid(const std::string& filename) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp) {
+        return false;
     }
-    std::cout << "Output directory: " << frames_dir << "/" << std::endl;
     
-    // Allocate image buffer
-    unsigned char* image_data = new unsigned char[WIDTH * HEIGHT * 3];
+    bool valid = false;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        if (g_format == FORMAT_PNG) {
+            static const unsigned char SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            static const unsigned char IEND[12] = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82};
+            unsigned char head[24];
+            unsigned char tail[12];
+            valid = size >= 24 + 12 &&
+                    fseek(fp, 0, SEEK_SET) == 0 && fread(head, 1, 24, fp) == 24 &&
+                    fseek(fp, -12, SEEK_END) == 0 && fread(tail, 1, 12, fp) == 12 &&
+                    std::memcmp(head, SIGNATURE, 8) == 0 && std::memcmp(head + 12, "IHDR", 4) == 0 &&
+                    read_be32(head + 16) == static_cast<unsigned int>(g_config.width) &&
+                    read_be32(head + 20) == static_cast<unsigned int>(g_config.height) &&
+                    std::memcmp(tail, IEND, 12) == 0;
+        } else {
+            C64Layout layout = g_multicolor ? C64_LAYOUT_MULTICOLOR : C64_LAYOUT_PACKED;
+            long expected = c64_frame_size(layout, g_config.width, g_config.height) + (g_multicolor ? 2 : 0);
+            valid = size == expected;
+        }
+    }
     
-    // Generate all frames
-    std::cout << "Generating frames..." << std::endl;
-    for (int frame = 0; frame < FRAMES; frame++) {
-        if (frame % 100 == 0) {
-            std::cout << "  Frame " << frame << "/" << FRAMES 
-                      << " (" << std::fixed << std::setprecision(1) 
-                      << (100.0 * frame / FRAMES) << "%)..." << std::endl;
+    fclose(fp);
+    return valid;
+}
+
+/**
+ * A finished frame travelling from a render thread to an encoder thread
+ */
+struct FrameBuffer {
+    int frame;
+    bool has_stats;         // false for frames resampled from a keyframe
+    FrameStats stats;
+    std::vector<unsigned char> pixels;      // RGB or palette indices, see pixel_size()
+    std::vector<unsigned char> encoded;     // C64 layout scratch space of the encoder
+};
+
+/**
+ * Shared state of the render and encode pipeline
+ * Render work units are handed out through an atomic counter, so every
+ * render thread picks the next unrendered unit; file names only depend on
+ * the frame number. A unit is a single frame, or a keyframe segment in
+ * --reuse mode. Only pending frames (inside the frame range and not already
+ * present when resuming) are rendered.
+ *
+ * Finished frames go through a lock-free ring to the encoder threads.
+ * Frame buffers come from a fixed pool (a second ring); when all buffers
+ * are waiting for encoding, render threads stall until an encoder hands
+ * one back, which bounds memory and applies backpressure.
+ */
+struct RenderJob {
+    std::string frames_dir;
+    int unit_frames;
+    std::vector<int> units;     // first frame of every work unit
+    std::vector<char> pending;  // per frame of the sequence: still to render
+    int frames_total;           // number of pending frames
+    int encoder_threads;    // 0: encode synchronously in the render threads
+    std::atomic<int> next_unit;
+    std::atomic<int> frames_done;
+    std::atomic<int> renderers_active;
+    std::atomic<int> deep_frames;
+    std::atomic<long long> samples;
+    std::atomic<long long> skipped;
+    std::atomic<long long> iterations;
+    std::atomic<long long> saved;
+    std::atomic<long long> interior;
+    std::atomic<long long> periodic;
+    std::atomic<long long> rebases;
+    std::atomic<long long> glitches;
+    std::atomic<long long> pixels;
+    std::atomic<long long> aa_pixels;
+    std::vector<int> budgets;               // iteration budget per rendered frame or keyframe
+    std::atomic<bool> failed;
+    std::mutex output_mutex;
+    FrameStreamWriter* stream;              // --format stream
+    DeltaStreamWriter* delta;               // --format delta
+    
+    // Pipeline between render and encoder threads
+    RingBuffer<FrameBuffer*>* encode_queue;
+    RingBuffer<FrameBuffer*>* free_buffers;
+    
+    // Per-stage timing, summed over all threads of a stage (nanoseconds)
+    std::atomic<long long> render_ns;       // computing and coloring frames
+    std::atomic<long long> render_wait_ns;  // blocked on a free frame buffer
+    std::atomic<long long> encode_ns;       // PNG compression and file output
+    std::atomic<long long> encode_idle_ns;  // waiting for frames to encode
+};
+
+typedef std::chrono::steady_clock Clock;
+
+long long elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/**
+ * Back off while waiting on the pipeline: spin briefly, then sleep
+ */
+void pipeline_wait(int attempt) {
+    if (attempt < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+/**
+ * Convert a frame of palette indices to the C64 layout of the output
+ * encoded receives two bytes of room for a load address, then the frame
+ * record; returns the record size.
+ */
+int convert_c64_frame(const unsigned char* indices, std::vector<unsigned char>* encoded) {
+    C64Layout layout = g_multicolor ? C64_LAYOUT_MULTICOLOR : C64_LAYOUT_PACKED;
+    int size = c64_frame_size(layout, g_config.width, g_config.height);
+    encoded->resize(size + 2);
+    if (g_multicolor) {
+        convert_multicolor(indices, encoded->data() + 2);
+    } else {
+        pack_nibbles(indices, g_config.width * g_config.height, encoded->data() + 2);
+    }
+    return size;
+}
+
+/**
+ * Save a finished frame and report progress
+ */
+bool encode_frame(RenderJob* job, FrameBuffer& buffer) {
+    Clock::time_point start = Clock::now();
+    
+    // Frame files are written under a temporary name and renamed when
+    // complete, so an interrupted run never leaves a truncated frame behind
+    std::string filename = frame_filename(job->frames_dir, buffer.frame);
+    std::string temp_filename = filename + ".tmp";
+    int stream_frame = buffer.frame - g_config.first_frame;
+    
+    bool ok;
+    if (g_format == FORMAT_PNG) {
+        // Save frame as PNG
+        ok = save_png(temp_filename, buffer.pixels.data(), g_config.width, g_config.height);
+    } else {
+        // Pack palette indices into the C64 layout
+        int size = convert_c64_frame(buffer.pixels.data(), &buffer.encoded);
+        unsigned char* data = buffer.encoded.data() + 2;
+        
+        if (g_format == FORMAT_STREAM) {
+            filename = STREAM_FILENAME;
+            ok = job->stream->write_frame(stream_frame, data);
+        } else if (g_format == FORMAT_DELTA) {
+            filename = DELTA_FILENAME;
+            ok = job->delta->write_frame(stream_frame, data);
+        } else if (g_multicolor) {
+            // Koala Painter file: load address, then the multicolor layout
+            buffer.encoded[0] = KOALA_LOAD_ADDRESS & 0xff;
+            buffer.encoded[1] = KOALA_LOAD_ADDRESS >> 8;
+            ok = save_raw(temp_filename, buffer.encoded.data(), size + 2);
+        } else {
+            ok = save_raw(temp_filename, data, size);
         }
+    }
+    if (ok && frame_files()) {
+        ok = std::rename(temp_filename.c_str(), filename.c_str()) == 0;
+    }
+    job->encode_ns += elapsed_ns(start);
+    
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(job->output_mutex);
+        std::cerr << "Error: Failed to save frame " << buffer.frame << " to " << filename << std::endl;
+        job->failed = true;
+        return false;
+    }
+    
+    int done = ++job->frames_done;
+    if (done % 100 == 0) {
+        std::lock_guard<std::mutex> lock(job->output_mutex);
+        std::cout << "  Frame " << done << "/" << job->frames_total
+                  << " (" << std::fixed << std::setprecision(1)
+                  << (100.0 * done / job->frames_total) << "%)...";
+        if (buffer.has_stats && g_shortcuts) {
+            std::cout << " frame " << buffer.frame << ": " << buffer.stats.kernel.iterations
+                      << " iterations, " << buffer.stats.kernel.saved << " saved";
+        }
+        std::cout << std::endl;
+    }
+    
+    return true;
+}
+
+/**
+ * Get a frame buffer to render into
+ * Blocks while every pooled buffer is queued for encoding (backpressure).
+ */
+FrameBuffer* acquire_buffer(RenderJob* job, FrameBuffer* local) {
+    if (job->encoder_threads == 0) {
+        return local;
+    }
+    
+    Clock::time_point start = Clock::now();
+    FrameBuffer* buffer = NULL;
+    for (int attempt = 0; !job->free_buffers->try_pop(buffer); attempt++) {
+        if (job->failed) {
+            return NULL;
+        }
+        pipeline_wait(attempt);
+    }
+    job->render_wait_ns += elapsed_ns(start);
+    
+    return buffer;
+}
+
+/**
+ * Hand a rendered frame to the encoders (or encode it right away)
+ */
+void submit_frame(RenderJob* job, FrameBuffer* buffer) {
+    if (job->encoder_threads == 0) {
+        encode_frame(job, *buffer);
+        return;
+    }
+    
+    // The queue holds as many entries as there are pooled buffers,
+    // so this only spins in the unlikely case of a racing consumer
+    for (int attempt = 0; !job->encode_queue->try_push(buffer); attempt++) {
+        pipeline_wait(attempt);
+    }
+}
+
+/**
+ * Encoder thread: compress and write frames until rendering has finished
+ * and the queue is drained
+ */
+void encode_worker(RenderJob* job) {
+    Clock::time_point idle_start = Clock::now();
+    int attempt = 0;
+    
+    for (;;) {
+        FrameBuffer* buffer = NULL;
+        if (job->encode_queue->try_pop(buffer)) {
+            job->encode_idle_ns += elapsed_ns(idle_start);
+            encode_frame(job, *buffer);
+            job->free_buffers->try_push(buffer);
+            idle_start = Clock::now();
+            attempt = 0;
+            continue;
+        }
+        
+        // Render threads push before they sign off, so once none are
+        // active an empty queue stays empty
+        if (job->renderers_active == 0 || job->failed) {
+            if (!job->encode_queue->try_pop(buffer)) {
+                break;
+            }
+            encode_frame(job, *buffer);
+            job->free_buffers->try_push(buffer);
+            continue;
+        }
+        pipeline_wait(attempt++);
+    }
+    
+    job->encode_idle_ns += elapsed_ns(idle_start);
+}
+
+/**
+ * Add the statistics of one rendered frame or keyframe to the job totals
+ * (frame must lie inside --frames, it picks the budget slot)
+ */
+void account_frame(RenderJob* job, int frame, const FrameStats& stats) {
+    job->budgets[frame - g_config.first_frame] = stats.max_iter;
+    job->samples += stats.samples;
+    job->skipped += stats.skipped;
+    job->iterations += stats.kernel.iterations;
+    job->saved += stats.kernel.saved;
+    job->interior += stats.kernel.interior;
+    job->periodic += stats.kernel.periodic;
+    job->pixels += stats.pixels;
+    job->aa_pixels += stats.aa_pixels;
+    if (stats.deep) {
+        job->deep_frames++;
+        job->rebases += stats.rebases;
+        job->glitches += stats.glitches;
+    }
+}
+
+/**
+ * Render thread: render frames until none are left
+ * Each render thread owns its iteration buffers and fills one frame buffer
+ * at a time, so no locking is needed on pixel data.
+ */
+void render_worker(RenderJob* job) {
+    FrameBuffer local;
+    local.pixels.resize(g_config.width * g_config.height * pixel_size());
+    std::vector<int> iterations(g_config.width * g_config.height);
+    std::vector<float> norms(g_smooth ? iterations.size() : 0);
+    std::vector<int> keyframe;
+    std::vector<float> keyframe_norms;
+    if (g_reuse) {
+        keyframe.resize(g_config.width * g_reuse_oversample * g_config.height * g_reuse_oversample);
+        keyframe_norms.resize(g_smooth ? keyframe.size() : 0);
+    }
+    float* frame_norms = g_smooth ? norms.data() : NULL;
+    
+    while (!job->failed) {
+        int unit = job->next_unit++;
+        if (unit >= static_cast<int>(job->units.size())) {
+            break;
+        }
+        int first = job->units[unit];
+        int last = std::min(first + job->unit_frames, g_config.last_frame + 1);
         
-        // Generate frame
-        generate_frame(frame, image_data);
+        if (!g_reuse) {
+            FrameBuffer* buffer = acquire_buffer(job, &local);
+            if (!buffer) {
+                break;
+            }
+            
+            // Generate frame
+            Clock::time_point start = Clock::now();
+            buffer->frame = first;
+            buffer->has_stats = true;
+            buffer->stats = FrameStats();
+            compute_iterations(first, g_config.width, g_config.height, iterations.data(), frame_norms,
+                               &buffer->stats);
+            shade_frame(iterations.data(), frame_norms, buffer->stats.max_iter, buffer->pixels.data());
+            account_frame(job, first, buffer->stats);
+            job->render_ns += elapsed_ns(start);
+            
+            submit_frame(job, buffer);
+            continue;
+        }
         
-        // Save frame as PNG
-        std::ostringstream filename;
-        filename << frames_dir << "/frame_" << std::setfill('0') << std::setw(4) << frame << ".png";
+        // Render the keyframe, then resample the pending frames of the segment.
+        // Keyframes stay aligned to the start of the sequence (they may lie
+        // before the frame range), so every shard produces the same frames.
+        Clock::time_point start = Clock::now();
+        FrameStats stats = FrameStats();
+        compute_iterations(first, g_config.width * g_reuse_oversample, g_config.height * g_reuse_oversample,
+                           keyframe.data(), g_smooth ? keyframe_norms.data() : NULL, &stats);
+        // A keyframe before the range counts for the first frame it resamples
+        account_frame(job, std::max(first, g_config.first_frame), stats);
+        job->render_ns += elapsed_ns(start);
         
-        if (!save_png(filename.str(), image_data, WIDTH, HEIGHT)) {
-            std::cerr << "Error: Failed to save frame " << frame << std::endl;
-            delete[] image_data;
+        for (int frame = first; frame < last && !job->failed; frame++) {
+            if (!job->pending[frame]) {
+                continue;
+            }
+            FrameBuffer* buffer = acquire_buffer(job, &local);
+            if (!buffer) {
+                break;
+            }
+            
+            start = Clock::now();
+            buffer->frame = frame;
+            buffer->has_stats = frame == first;
+            buffer->stats = stats;
+            resample_keyframe(keyframe, keyframe_norms, first, frame, iterations.data(), frame_norms);
+            shade_frame(iterations.data(), frame_norms, stats.max_iter, buffer->pixels.data());
+            job->render_ns += elapsed_ns(start);
+            
+            submit_frame(job, buffer);
+        }
+    }
+    
+    job->renderers_active--;
+}
+
+/**
+ * One benchmark measurement: a case rendered with one kernel and thread count
+ */
+struct BenchmarkResult {
+    const char* kernel;
+    int threads;
+    const BenchmarkCase* test;
+    int frames;
+    double seconds;         // wall clock
+    long long iterations;
+    double compute_s;       // per-stage time, summed over threads
+    double color_s;
+    double encode_s;
+    
+    double mpixels_per_s() const {
+        return static_cast<double>(g_config.width) * g_config.height * frames / seconds * 1e-6;
+    }
+    double iterations_per_s() const {
+        return iterations / seconds;
+    }
+};
+
+/**
+ * Shared state of the threads of one benchmark measurement
+ */
+struct BenchmarkRun {
+    int first_frame;
+    std::atomic<int> next_frame;
+    std::atomic<long long> iterations;
+    std::atomic<long long> compute_ns;
+    std::atomic<long long> color_ns;
+    std::atomic<long long> encode_ns;
+    std::atomic<bool> failed;
+};
+
+/**
+ * Benchmark thread: render, color and encode frames of the case until none
+ * are left. PNG frames are compressed into BENCHMARK_PNG_SINK, C64 frames
+ * are only converted, so the disk does not distort the timing.
+ */
+void benchmark_worker(BenchmarkRun* run) {
+    std::vector<int> iterations(g_config.width * g_config.height);
+    std::vector<float> norms(g_smooth ? iterations.size() : 0);
+    std::vector<unsigned char> pixels(iterations.size() * pixel_size());
+    std::vector<unsigned char> encoded;
+    float* frame_norms = g_smooth ? norms.data() : NULL;
+    
+    for (;;) {
+        int index = run->next_frame++;
+        if (index >= BENCHMARK_FRAMES || run->failed) {
+            break;
+        }
+        
+        FrameStats stats = FrameStats();
+        Clock::time_point start = Clock::now();
+        compute_iterations(run->first_frame + index, g_config.width, g_config.height, iterations.data(),
+                           frame_norms, &stats);
+        run->compute_ns += elapsed_ns(start);
+        run->iterations += stats.kernel.iterations;
+        
+        start = Clock::now();
+        shade_frame(iterations.data(), frame_norms, stats.max_iter, pixels.data());
+        run->color_ns += elapsed_ns(start);
+        
+        start = Clock::now();
+        if (g_format == FORMAT_PNG) {
+            if (!save_png(BENCHMARK_PNG_SINK, pixels.data(), g_config.width, g_config.height)) {
+                run->failed = true;
+            }
+        } else {
+            convert_c64_frame(pixels.data(), &encoded);
+        }
+        run->encode_ns += elapsed_ns(start);
+    }
+}
+
+/**
+ * Measure one case with the current kernel (g_kernel) and a thread count
+ */
+bool benchmark_case(const BenchmarkCase& test, int threads, BenchmarkResult* result) {
+    BenchmarkRun run;
+    run.first_frame = test.frame;
+    run.next_frame = 0;
+    run.iterations = 0;
+    run.compute_ns = 0;
+    run.color_ns = 0;
+    run.encode_ns = 0;
+    run.failed = false;
+    
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread(benchmark_worker, &run));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    
+    result->kernel = g_kernel->name;
+    result->threads = threads;
+    result->test = &test;
+    result->frames = BENCHMARK_FRAMES;
+    result->seconds = elapsed_ns(start) * 1e-9;
+    result->iterations = run.iterations;
+    result->compute_s = run.compute_ns * 1e-9;
+    result->color_s = run.color_ns * 1e-9;
+    result->encode_s = run.encode_ns * 1e-9;
+    return !run.failed;
+}
+
+/**
+ * Write the benchmark results for regression tracking
+ */
+void write_benchmark_reports(const std::vector<BenchmarkResult>& results, const std::string& format_name) {
+    std::ofstream json(BENCHMARK_JSON_FILENAME);
+    json << std::setprecision(6);
+    json << "{" << std::endl;
+    json << "  \"width\": " << g_config.width << "," << std::endl;
+    json << "  \"height\": " << g_config.height << "," << std::endl;
+    json << "  \"max_iter\": " << g_config.max_iter << "," << std::endl;
+    json << "  \"frames_per_case\": " << BENCHMARK_FRAMES << "," << std::endl;
+    json << "  \"format\": \"" << format_name << "\"," << std::endl;
+    json << "  \"results\": [" << std::endl;
+    for (size_t r = 0; r < results.size(); r++) {
+        const BenchmarkResult& result = results[r];
+        json << "    {\"kernel\": \"" << result.kernel << "\", \"threads\": " << result.threads
+             << ", \"case\": \"" << result.test->name << "\", \"frame\": " << result.test->frame
+             << ", \"seconds\": " << result.seconds
+             << ", \"mpixels_per_s\": " << result.mpixels_per_s()
+             << ", \"iterations\": " << result.iterations
+             << ", \"iterations_per_s\": " << result.iterations_per_s()
+             << ", \"compute_s\": " << result.compute_s
+             << ", \"color_s\": " << result.color_s
+             << ", \"encode_s\": " << result.encode_s << "}"
+             << (r + 1 < results.size() ? "," : "") << std::endl;
+    }
+    json << "  ]" << std::endl;
+    json << "}" << std::endl;
+    if (!json) {
+        std::cerr << "Warning: Could not write " << BENCHMARK_JSON_FILENAME << std::endl;
+    }
+    
+    std::ofstream csv(BENCHMARK_CSV_FILENAME);
+    csv << std::setprecision(6);
+    csv << "kernel,threads,case,frame,seconds,mpixels_per_s,iterations,iterations_per_s,compute_s,color_s,encode_s" << std::endl;
+    for (size_t r = 0; r < results.size(); r++) {
+        const BenchmarkResult& result = results[r];
+        csv << result.kernel << "," << result.threads << "," << result.test->name << "," << result.test->frame
+            << "," << result.seconds << "," << result.mpixels_per_s() << "," << result.iterations
+            << "," << result.iterations_per_s() << "," << result.compute_s << "," << result.color_s
+            << "," << result.encode_s << std::endl;
+    }
+    if (!csv) {
+        std::cerr << "Warning: Could not write " << BENCHMARK_CSV_FILENAME << std::endl;
+    }
+}
+
+/**
+ * Benchmark mode: render the benchmark cases with every kernel (or only
+ * the one given with --kernel) and every thread count
+ */
+int run_benchmark(const std::vector<int>& thread_counts, const std::string& kernel_name,
+                  const std::string& format_name) {
+    std::vector<const KernelInfo*> kernels;
+    if (kernel_name == "auto") {
+        for (int k = 0; KERNELS[k].name; k++) {
+            if (kernel_supported(KERNELS[k])) {
+                kernels.push_back(&KERNELS[k]);
+            }
+        }
+    } else {
+        kernels.push_back(g_kernel);
+    }
+    
+    std::cout << "Benchmarking Mandelbrot zoom rendering..." << std::endl;
+    std::cout << "  Resolution: " << g_config.width << "x" << g_config.height << " pixels, "
+              << BENCHMARK_FRAMES << " frames per case" << std::endl;
+    std::cout << "  Iterations: " << (g_adaptive_iter ? "adaptive, up to " : "") << g_config.max_iter
+              << (g_smooth ? " (smooth coloring)" : "") << std::endl;
+    std::cout << "  Shortcuts: " << (g_shortcuts ? "on" : "off")
+              << ", subdivision: " << (g_subdivide ? "on" : "off")
+              << ", anti-aliasing: " << (g_aa != AA_OFF ? "on" : "off")
+              << ", output: " << format_name << std::endl;
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(8) << "kernel" << std::right << std::setw(8) << "threads"
+              << "  " << std::left << std::setw(9) << "case" << std::right
+              << std::setw(10) << "Mpix/s" << std::setw(14) << "iterations" << std::setw(10) << "Giter/s"
+              << std::setw(10) << "compute" << std::setw(8) << "color" << std::setw(8) << "encode" << std::endl;
+    
+    std::vector<BenchmarkResult> results;
+    for (size_t k = 0; k < kernels.size(); k++) {
+        g_kernel = kernels[k];
+        for (size_t t = 0; t < thread_counts.size(); t++) {
+            for (int c = 0; BENCHMARK_CASES[c].name; c++) {
+                const BenchmarkCase& test = BENCHMARK_CASES[c];
+                if (test.frame + BENCHMARK_FRAMES > g_config.frames) {
+                    continue;   // not part of a shorter sequence
+                }
+                BenchmarkResult result;
+                if (!benchmark_case(test, thread_counts[t], &result)) {
+                    std::cerr << "Error: Could not encode benchmark frames" << std::endl;
+                    return 1;
+                }
+                results.push_back(result);
+                
+                // Stage split as share of the busy time of all threads
+                double busy = result.compute_s + result.color_s + result.encode_s;
+                std::cout << std::left << std::setw(8) << result.kernel << std::right << std::setw(8) << result.threads
+                          << "  " << std::left << std::setw(9) << test.name << std::right << std::fixed
+                          << std::setprecision(2) << std::setw(10) << result.mpixels_per_s()
+                          << std::setw(14) << result.iterations
+                          << std::setw(10) << result.iterations_per_s() * 1e-9
+                          << std::setprecision(1)
+                          << std::setw(9) << 100.0 * result.compute_s / busy << "%"
+                          << std::setw(7) << 100.0 * result.color_s / busy << "%"
+                          << std::setw(7) << 100.0 * result.encode_s / busy << "%" << std::endl;
+            }
+        }
+    }
+    
+    write_benchmark_reports(results, format_name);
+    std::cout << std::endl;
+    std::cout << "Results saved to: " << BENCHMARK_JSON_FILENAME << ", " << BENCHMARK_CSV_FILENAME << std::endl;
+    return 0;
+}
+
+/**
+ * Summarize the delta stream and write the per-frame size report
+ * The report lists stored and changed bytes of every frame, which is what
+ * the C64 side has to fetch and write per frame.
+ */
+void print_delta_report(const DeltaStreamWriter& delta, long long frame_bytes) {
+    const std::vector<int>& sizes = delta.frame_bytes();
+    const std::vector<int>& changed = delta.changed_bytes();
+    
+    std::ofstream report(DELTA_REPORT_FILENAME);
+    report << "frame,bytes,changed_bytes" << std::endl;
+    
+    long long total = 0;
+    int largest = 0;
+    for (size_t f = 0; f < sizes.size(); f++) {
+        report << f << "," << sizes[f] << "," << changed[f] << std::endl;
+        total += sizes[f];
+        if (f > 0 && sizes[f] > sizes[largest]) {
+            largest = static_cast<int>(f);
+        }
+    }
+    if (!report) {
+        std::cerr << "Warning: Could not write " << DELTA_REPORT_FILENAME << std::endl;
+    }
+    
+    // The first frame is stored against an empty frame, so report it separately
+    long long deltas = total - sizes[0];
+    int delta_frames = static_cast<int>(sizes.size()) - 1;
+    double average = delta_frames > 0 ? static_cast<double>(deltas) / delta_frames : 0.0;
+    std::cout << "Delta stream: " << total << " bytes (" << std::setprecision(1)
+              << (100.0 * total / (frame_bytes * static_cast<double>(sizes.size())))
+              << "% of the full frames)" << std::endl;
+    std::cout << "  First frame: " << sizes[0] << " bytes" << std::endl;
+    std::cout << "  Delta frames: " << std::setprecision(0) << average << " bytes average, "
+              << sizes[largest] << " bytes max (frame " << largest << "), "
+              << std::setprecision(1) << (average * 25 / 1024.0) << " KB/s at 25 fps" << std::endl;
+}
+
+/**
+ * Options that take no value
+ * In job files they are written as "name = true" (or false to leave them off).
+ */
+bool is_flag_option(const std::string& name) {
+    static const char* FLAGS[] = {
+        "no-shortcuts", "subdivide", "deep", "reuse", "multicolor", "resume", "adaptive-iter", "smooth",
+        "benchmark", NULL
+    };
+    for (int i = 0; FLAGS[i]; i++) {
+        if (name == FLAGS[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Read a job file and return its settings as command line arguments
+ * Every line holds "name = value" for a long option without the leading
+ * dashes, e.g. "max-iter = 1024" or "reuse = true". Blank lines and lines
+ * starting with # are ignored.
+ */
+bool load_job_file(const std::string& filename, std::vector<std::string>* args) {
+    std::ifstream file(filename.c_str());
+    if (!file) {
+        std::cerr << "Error: Could not open job file: " << filename << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << "Error: " << filename << ":" << line_number << ": expected name = value" << std::endl;
+            return false;
+        }
+        std::string name = line.substr(start, equals - start);
+        std::string value = line.substr(equals + 1);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        
+        if (is_flag_option(name)) {
+            if (value == "true" || value == "yes" || value == "1") {
+                args->push_back("--" + name);
+            } else if (value != "false" && value != "no" && value != "0") {
+                std::cerr << "Error: " << filename << ":" << line_number << ": " << name
+                          << " must be true or false" << std::endl;
+                return false;
+            }
+        } else {
+            args->push_back("--" + name);
+            args->push_back(value);
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Parse a frame range: "A-B", "A-" (to the last frame) or a single frame "N"
+ */
+bool parse_frame_range(const std::string& text, int* first, int* last) {
+    char* end = NULL;
+    *first = static_cast<int>(std::strtol(text.c_str(), &end, 10));
+    if (end == text.c_str()) {
+        return false;
+    }
+    if (*end == '\0') {
+        *last = *first;
+        return true;
+    }
+    if (*end != '-') {
+        return false;
+    }
+    
+    const char* second = end + 1;
+    if (*second == '\0') {
+        *last = -1;
+        return true;
+    }
+    *last = static_cast<int>(std::strtol(second, &end, 10));
+    return end != second && *end == '\0';
+}
+
+/**
+ * Parameters that determine the content of the output files, in job file
+ * syntax. Written next to the frames so a resumed or sharded run can check
+ * that existing frames belong to the same job, and reusable with --config.
+ */
+std::string job_description(const std::string& format_name, const std::string& aa_pattern_name) {
+    std::ostringstream text;
+    text << std::setprecision(17);
+    text << "# Mandelbrot zoom render job" << std::endl;
+    text << "width = " << g_config.width << std::endl;
+    text << "height = " << g_config.height << std::endl;
+    text << "frame-count = " << g_config.frames << std::endl;
+    text << "max-iter = " << g_config.max_iter << std::endl;
+    text << "adaptive-iter = " << (g_adaptive_iter ? "true" : "false") << std::endl;
+    text << "smooth = " << (g_smooth ? "true" : "false") << std::endl;
+    text << "aa = " << aa_pattern_name << std::endl;
+    text << "aa-samples = " << g_aa_samples << std::endl;
+    text << "zoom-factor = " << g_config.zoom_factor << std::endl;
+    text << "center-x = " << g_config.center_x << std::endl;
+    text << "center-y = " << g_config.center_y << std::endl;
+    text << "subdivide = " << (g_subdivide ? "true" : "false") << std::endl;
+    text << "deep = " << (g_deep_zoom ? "true" : "false") << std::endl;
+    text << "reuse = " << (g_reuse ? "true" : "false") << std::endl;
+    text << "reuse-oversample = " << g_reuse_oversample << std::endl;
+    text << "reuse-threshold = " << g_reuse_threshold << std::endl;
+    text << "format = " << format_name << std::endl;
+    text << "multicolor = " << (g_multicolor ? "true" : "false") << std::endl;
+    return text.str();
+}
+
+/**
+ * Print command line usage
+ */
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [-j N] [-e N] [--queue N] [--kernel NAME] [--no-shortcuts] [--subdivide] [--deep]" << std::endl;
+    std::cout << "       [--reuse] [--reuse-oversample F] [--reuse-threshold T] [--format FORMAT] [--multicolor]" << std::endl;
+    std::cout << "       [--config FILE] [--frames A-B] [--resume] [--width W] [--height H] [--frame-count N]" << std::endl;
+    std::cout << "       [--max-iter N] [--adaptive-iter] [--smooth] [--zoom-factor Z] [--center-x X] [--center-y Y]" << std::endl;
+    std::cout << "       [--aa PATTERN] [--aa-samples N] [--benchmark] [--bench-threads LIST]" << std::endl;
+    std::cout << "  -j N           Number of render threads (default: hardware thread count)" << std::endl;
+    std::cout << "  -e N           Number of PNG encoder threads, 0 encodes in the render threads" << std::endl;
+    std::cout << "                 (default: one per four render threads)" << std::endl;
+    std::cout << "  --queue N      Frame buffers in flight between render and encode (default: 2 per thread)" << std::endl;
+    std::cout << "  --kernel NAME  Escape-time kernel: auto, avx512, avx2, sse2, scalar (default: auto)" << std::endl;
+    std::cout << "  --no-shortcuts Disable interior and periodicity shortcuts" << std::endl;
+    std::cout << "  --subdivide    Fill tiles with a uniform border without iterating (Mariani-Silver)" << std::endl;
+    std::cout << "  --deep         Render deep frames with perturbation theory" << std::endl;
+    std::cout << "  --reuse        Resample frames from oversampled keyframes" << std::endl;
+    std::cout << "  --reuse-oversample F  Keyframe oversampling per axis (default: 2)" << std::endl;
+    std::cout << "  --reuse-threshold T   Max keyframe sample spacing in output pixels (default: 1.0)" << std::endl;
+    std::cout << "  --format FORMAT       png (RGB), raw (4-bit palette indices per file) or" << std::endl;
+    std::cout << "                        stream (all frames in " << STREAM_FILENAME << ") or delta (changes" << std::endl;
+    std::cout << "                        between frames in " << DELTA_FILENAME << ") (default: png)" << std::endl;
+    std::cout << "  --multicolor          Write raw/stream/delta frames in C64 multicolor bitmap layout" << std::endl;
+    std::cout << "  --config FILE         Read options from a job file (\"name = value\" per line)" << std::endl;
+    std::cout << "  --frames A-B          Render only frames A to B of the sequence (A-, or a single frame N)" << std::endl;
+    std::cout << "  --resume              Skip frames already present and complete (png and raw output)" << std::endl;
+    std::cout << "  --width W, --height H Resolution (default: 320x200)" << std::endl;
+    std::cout << "  --frame-count N       Frames in the whole sequence (default: 4000)" << std::endl;
+    std::cout << "  --max-iter N          Maximum iterations (default: 256)" << std::endl;
+    std::cout << "  --adaptive-iter       Choose the iterations per frame from its zoom depth and escape" << std::endl;
+    std::cout << "                        histogram, up to --max-iter" << std::endl;
+    std::cout << "  --smooth              Smooth coloring from the escape magnitude |z|" << std::endl;
+    std::cout << "  --zoom-factor Z       Zoom factor per frame (default: 1.02)" << std::endl;
+    std::cout << "  --center-x X, --center-y Y  Zoom center (default: seahorse valley)" << std::endl;
+    std::cout << "  --aa PATTERN          Supersample pixels on color edges: off, grid, rgss (rotated grid)" << std::endl;
+    std::cout << "                        or jitter (default: off)" << std::endl;
+    std::cout << "  --aa-samples N        Samples per edge pixel, a square from 4 to " << AA_MAX_GRID * AA_MAX_GRID << " (default: 4)" << std::endl;
+    std::cout << "  --benchmark           Time representative frames with every kernel instead of rendering;" << std::endl;
+    std::cout << "                        results go to " << BENCHMARK_JSON_FILENAME << " and " << BENCHMARK_CSV_FILENAME << std::endl;
+    std::cout << "  --bench-threads LIST  Comma separated thread counts to benchmark (default: 1 and -j)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    // Default to one render thread per hardware thread
+    int num_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    int encoder_threads = -1;
+    int queue_size = 0;
+    std::string kernel_name = "auto";
+    std::string format_name = "png";
+    std::string aa_pattern_name = "off";
+    int first_frame = 0;
+    int last_frame = -1;
+    bool resume = false;
+    bool benchmark = false;
+    std::vector<int> bench_threads;
+    
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string arg = args[i];
+        bool has_value = i + 1 < args.size();
+        if (arg == "-j" && has_value) {
+            num_threads = std::atoi(args[++i].c_str());
+        } else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+            num_threads = std::atoi(arg.c_str() + 2);
+        } else if (arg == "-e" && has_value) {
+            encoder_threads = std::atoi(args[++i].c_str());
+        } else if (arg == "--queue" && has_value) {
+            queue_size = std::atoi(args[++i].c_str());
+        } else if (arg == "--kernel" && has_value) {
+            kernel_name = args[++i].c_str();
+        } else if (arg == "--no-shortcuts") {
+            g_shortcuts = false;
+        } else if (arg == "--subdivide") {
+            g_subdivide = true;
+        } else if (arg == "--deep") {
+            g_deep_zoom = true;
+        } else if (arg == "--reuse") {
+            g_reuse = true;
+        } else if (arg == "--reuse-oversample" && has_value) {
+            g_reuse_oversample = std::atoi(args[++i].c_str());
+        } else if (arg == "--reuse-threshold" && has_value) {
+            g_reuse_threshold = std::atof(args[++i].c_str());
+        } else if (arg == "--format" && has_value) {
+            format_name = args[++i].c_str();
+        } else if (arg == "--multicolor") {
+            g_multicolor = true;
+        } else if (arg == "--config" && has_value) {
+            // Job file settings take effect at this point of the command line
+            std::vector<std::string> job_args;
+            if (!load_job_file(args[++i], &job_args)) {
+                return 1;
+            }
+            args.insert(args.begin() + i + 1, job_args.begin(), job_args.end());
+        } else if (arg == "--frames" && has_value) {
+            if (!parse_frame_range(args[++i], &first_frame, &last_frame)) {
+                std::cerr << "Error: Invalid frame range: " << args[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--aa" && has_value) {
+            aa_pattern_name = args[++i];
+        } else if (arg == "--aa-samples" && has_value) {
+            g_aa_samples = std::atoi(args[++i].c_str());
+        } else if (arg == "--benchmark") {
+            benchmark = true;
+        } else if (arg == "--bench-threads" && has_value) {
+            std::istringstream list(args[++i]);
+            std::string count;
+            while (std::getline(list, count, ',')) {
+                bench_threads.push_back(std::atoi(count.c_str()));
+            }
+        } else if (arg == "--width" && has_value) {
+            g_config.width = std::atoi(args[++i].c_str());
+        } else if (arg == "--height" && has_value) {
+            g_config.height = std::atoi(args[++i].c_str());
+        } else if (arg == "--frame-count" && has_value) {
+            g_config.frames = std::atoi(args[++i].c_str());
+        } else if (arg == "--max-iter" && has_value) {
+            g_config.max_iter = std::atoi(args[++i].c_str());
+        } else if (arg == "--adaptive-iter") {
+            g_adaptive_iter = true;
+        } else if (arg == "--smooth") {
+            g_smooth = true;
+        } else if (arg == "--zoom-factor" && has_value) {
+            g_config.zoom_factor = std::atof(args[++i].c_str());
+        } else if (arg == "--center-x" && has_value) {
+            g_config.center_x = std::atof(args[++i].c_str());
+        } else if (arg == "--center-y" && has_value) {
+            g_config.center_y = std::atof(args[++i].c_str());
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "Error: Unknown argument: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (num_threads < 1) {
+        std::cerr << "Error: Thread count must be at least 1" << std::endl;
+        return 1;
+    }
+    
+    if (encoder_threads < 0) {
+        encoder_threads = std::max(1, num_threads / 4);
+    }
+    if (queue_size <= 0) {
+        queue_size = 2 * (num_threads + encoder_threads);
+    }
+    
+    if (g_reuse_oversample < 1 || g_reuse_threshold <= 0.0) {
+        std::cerr << "Error: Keyframe oversampling must be at least 1 and the threshold positive" << std::endl;
+        return 1;
+    }
+    
+    if (format_name == "png") {
+        g_format = FORMAT_PNG;
+    } else if (format_name == "raw") {
+        g_format = FORMAT_RAW;
+    } else if (format_name == "stream") {
+        g_format = FORMAT_STREAM;
+    } else if (format_name == "delta") {
+        g_format = FORMAT_DELTA;
+    } else {
+        std::cerr << "Error: Unknown output format: " << format_name << std::endl;
+        return 1;
+    }
+    if (aa_pattern_name == "off") {
+        g_aa = AA_OFF;
+    } else if (aa_pattern_name == "grid") {
+        g_aa = AA_GRID;
+    } else if (aa_pattern_name == "rgss") {
+        g_aa = AA_RGSS;
+    } else if (aa_pattern_name == "jitter") {
+        g_aa = AA_JITTER;
+    } else {
+        std::cerr << "Error: Unknown anti-aliasing pattern: " << aa_pattern_name << std::endl;
+        return 1;
+    }
+    if (g_aa_samples < 4 || g_aa_samples > AA_MAX_GRID * AA_MAX_GRID ||
+        aa_grid_size() * aa_grid_size() != g_aa_samples) {
+        std::cerr << "Error: --aa-samples must be a square number from 4 to " << AA_MAX_GRID * AA_MAX_GRID << std::endl;
+        return 1;
+    }
+    if (g_multicolor && g_format == FORMAT_PNG) {
+        std::cerr << "Error: --multicolor requires --format raw, stream or delta" << std::endl;
+        return 1;
+    }
+    
+    if (g_config.width < 2 || g_config.height < 2 || g_config.frames < 1 ||
+        g_config.max_iter < 1 || !(g_config.zoom_factor > 1.0)) {
+        std::cerr << "Error: Invalid animation parameters (resolution, frame count, iterations or zoom factor)" << std::endl;
+        return 1;
+    }
+    if (g_multicolor && (g_config.width != C64_COLUMNS * 8 || g_config.height != C64_ROWS * 8)) {
+        std::cerr << "Error: --multicolor requires a " << C64_COLUMNS * 8 << "x" << C64_ROWS * 8 << " resolution" << std::endl;
+        return 1;
+    }
+    if (g_format != FORMAT_PNG && g_config.width % 2 != 0) {
+        std::cerr << "Error: Packed 4-bit output requires an even width" << std::endl;
+        return 1;
+    }
+    
+    // Frame range of this job (the whole sequence by default)
+    if (last_frame < 0) {
+        last_frame = g_config.frames - 1;
+    }
+    if (first_frame < 0 || first_frame > last_frame || last_frame >= g_config.frames) {
+        std::cerr << "Error: Frame range must lie within 0-" << (g_config.frames - 1) << std::endl;
+        return 1;
+    }
+    g_config.first_frame = first_frame;
+    g_config.last_frame = last_frame;
+    int range_frames = last_frame - first_frame + 1;
+    
+    if (!frame_files()) {
+        // Stream files hold the frame range in one file with 16-bit fields
+        C64Layout stream_layout = g_multicolor ? C64_LAYOUT_MULTICOLOR : C64_LAYOUT_PACKED;
+        if (resume) {
+            std::cerr << "Error: --resume requires per-frame output (--format png or raw)" << std::endl;
+            return 1;
+        }
+        if (range_frames > 65535 || g_config.width > 65535 || g_config.height > 65535 ||
+            c64_frame_size(stream_layout, g_config.width, g_config.height) > 64000) {
+            std::cerr << "Error: Frame range or resolution too large for a stream file" << std::endl;
             return 1;
         }
     }
     
-    delete[] image_data;
+    g_kernel = select_kernel(kernel_name.c_str());
+    if (!g_kernel) {
+        std::cerr << "Error: Kernel not available on this CPU: " << kernel_name << std::endl;
+        return 1;
+    }
+    
+    if (benchmark) {
+        // The deep case needs perturbation; shallower frames are not affected
+        g_deep_zoom = true;
+        if (bench_threads.empty()) {
+            bench_threads.push_back(1);
+            if (num_threads > 1) {
+                bench_threads.push_back(num_threads);
+            }
+        }
+        for (size_t t = 0; t < bench_threads.size(); t++) {
+            if (bench_threads[t] < 1) {
+                std::cerr << "Error: Invalid benchmark thread count" << std::endl;
+                return 1;
+            }
+        }
+        return run_benchmark(bench_threads, kernel_name, format_name);
+    }
+    
+    std::cout << "Generating Mandelbrot endless zoom animation..." << std::endl;
+    std::cout << "  Resolution: " << g_config.width << "x" << g_config.height << " pixels" << std::endl;
+    std::cout << "  Frames: " << g_config.frames;
+    if (range_frames < g_config.frames) {
+        std::cout << " (rendering " << first_frame << "-" << last_frame << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "  Render threads: " << num_threads << std::endl;
+    if (encoder_threads > 0) {
+        std::cout << "  Encoder threads: " << encoder_threads << " (" << queue_size << " frame buffers)" << std::endl;
+    } else {
+        std::cout << "  Encoder threads: none (synchronous encoding)" << std::endl;
+    }
+    std::cout << "  Kernel: " << g_kernel->name << " (" << g_kernel->lanes << " lanes)" << std::endl;
+    std::cout << "  Shortcuts: " << (g_shortcuts ? "cardioid/bulb + periodicity" : "off") << std::endl;
+    std::cout << "  Subdivision: " << (g_subdivide ? "Mariani-Silver" : "off") << std::endl;
+    std::cout << "  Deep zoom: " << (g_deep_zoom ? "perturbation" : "off") << std::endl;
+    std::cout << "  Iterations: " << (g_adaptive_iter ? "adaptive, up to " : "") << g_config.max_iter
+              << (g_smooth ? " (smooth coloring)" : "") << std::endl;
+    if (g_aa != AA_OFF) {
+        std::cout << "  Anti-aliasing: " << aa_pattern_name << ", " << g_aa_samples << " samples per edge pixel" << std::endl;
+    }
+    if (g_reuse) {
+        std::cout << "  Keyframe reuse: " << g_reuse_oversample << "x oversampled, threshold "
+                  << g_reuse_threshold << " (" << reuse_segment_length() << " frames per keyframe)" << std::endl;
+    }
+    std::cout << "  Output: " << format_name;
+    if (g_format != FORMAT_PNG) {
+        std::cout << (g_multicolor ? ", C64 multicolor bitmap" : ", 4-bit packed");
+    }
+    std::cout << std::endl;
+    std::cout << "  Zoom center: (" << g_config.center_x << ", " << g_config.center_y << ")" << std::endl;
+    std::cout << "  Zoom factor per frame: " << g_config.zoom_factor << std::endl;
+    std::cout << "  Final zoom level: " << std::scientific << std::pow(g_config.zoom_factor, g_config.frames) << "x" << std::endl;
+    
+    // Create output directory for frame files
+    RenderJob job;
+    job.frames_dir = "frames";
+    job.unit_frames = g_reuse ? reuse_segment_length() : 1;
+    job.encoder_threads = encoder_threads;
+    job.next_unit = 0;
+    job.frames_done = 0;
+    job.renderers_active = num_threads;
+    job.deep_frames = 0;
+    job.samples = 0;
+    job.skipped = 0;
+    job.iterations = 0;
+    job.saved = 0;
+    job.interior = 0;
+    job.periodic = 0;
+    job.rebases = 0;
+    job.glitches = 0;
+    job.pixels = 0;
+    job.aa_pixels = 0;
+    job.budgets.assign(range_frames, 0);
+    job.failed = false;
+    job.stream = NULL;
+    job.delta = NULL;
+    job.render_ns = 0;
+    job.render_wait_ns = 0;
+    job.encode_ns = 0;
+    job.encode_idle_ns = 0;
+    
+    C64Layout layout = g_multicolor ? C64_LAYOUT_MULTICOLOR : C64_LAYOUT_PACKED;
+    FrameStreamWriter stream;
+    DeltaStreamWriter delta;
+    if (g_format == FORMAT_STREAM) {
+        if (!stream.open(STREAM_FILENAME, layout, g_config.width, g_config.height, range_frames)) {
+            std::cerr << "Error: Could not create stream file: " << STREAM_FILENAME << std::endl;
+            return 1;
+        }
+        job.stream = &stream;
+        std::cout << "Output file: " << STREAM_FILENAME << std::endl;
+    } else if (g_format == FORMAT_DELTA) {
+        if (!delta.open(DELTA_FILENAME, layout, g_config.width, g_config.height, range_frames)) {
+            std::cerr << "Error: Could not create delta stream file: " << DELTA_FILENAME << std::endl;
+            return 1;
+        }
+        job.delta = &delta;
+        std::cout << "Output file: " << DELTA_FILENAME << std::endl;
+    } else {
+        if (!ensure_directory(job.frames_dir)) {
+            std::cerr << "Error: Could not create directory: " << job.frames_dir << std::endl;
+            return 1;
+        }
+        std::cout << "Output directory: " << job.frames_dir << "/" << std::endl;
+        
+        // Record the job next to its frames; existing frames are only reused
+        // if they were rendered with the same parameters
+        std::string description = job_description(format_name, aa_pattern_name);
+        std::string job_filename = job.frames_dir + "/" + JOB_FILENAME;
+        if (resume) {
+            std::ifstream previous(job_filename.c_str());
+            std::stringstream previous_description;
+            previous_description << previous.rdbuf();
+            if (previous && previous_description.str() != description) {
+                std::cerr << "Error: " << job_filename << " describes a different job, "
+                          << "refusing to resume with these parameters" << std::endl;
+                return 1;
+            }
+        }
+        std::ofstream job_file(job_filename.c_str());
+        job_file << description;
+        if (!job_file) {
+            std::cerr << "Error: Could not write " << job_filename << std::endl;
+            return 1;
+        }
+    }
     
-    std::cout << "Done! Generated " << FRAMES << " frames" << std::endl;
-    std::cout << "PNG frames saved to: " << frames_dir << "/" << std::endl;
-    std::cout << "\nTo create a video from frames, you can use ffmpeg:" << std::endl;
-    std::cout << "  ffmpeg -framerate 25 -i frames/frame_%04d.png -c:v libx264 -pix_fmt yuv420p mandelbrot_zoom.mp4" << std::endl;
+    // Pending frames and the work units covering them; keyframe segments
+    // are aligned to frame 0 so sharded runs resample the same way
+    job.pending.assign(g_config.frames, 0);
+    job.frames_total = 0;
+    for (int frame = first_frame; frame <= last_frame; frame++) {
+        if (resume && frame_file_valid(frame_filename(job.frames_dir, frame))) {
+            continue;
+        }
+        job.pending[frame] = 1;
+        job.frames_total++;
+        
+        int unit = frame - frame % job.unit_frames;
+        if (job.units.empty() || job.units.back() != unit) {
+            job.units.push_back(unit);
+        }
+    }
+    if (resume) {
+        std::cout << "Resuming: " << (range_frames - job.frames_total) << " of " << range_frames
+                  << " frames already present" << std::endl;
+    }
+    
+    // Frame buffer pool and queue between render and encoder threads
+    RingBuffer<FrameBuffer*> encode_queue(queue_size);
+    RingBuffer<FrameBuffer*> free_buffers(queue_size);
+    std::vector<FrameBuffer> buffer_pool(encoder_threads > 0 ? queue_size : 0);
+    for (size_t b = 0; b < buffer_pool.size(); b++) {
+        buffer_pool[b].pixels.resize(g_config.width * g_config.height * pixel_size());
+        free_buffers.try_push(&buffer_pool[b]);
+    }
+    job.encode_queue = &encode_queue;
+    job.free_buffers = &free_buffers;
+    
+    // Generate all frames in parallel
+    std::cout << "Generating frames..." << std::endl;
+    Clock::time_point run_start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+        workers.push_back(std::thread(render_worker, &job));
+    }
+    for (int t = 0; t < encoder_threads; t++) {
+        workers.push_back(std::thread(encode_worker, &job));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    double run_seconds = elapsed_ns(run_start) * 1e-9;
+    
+    if (g_format == FORMAT_STREAM && !stream.close()) {
+        std::cerr << "Error: Failed to write stream file: " << STREAM_FILENAME << std::endl;
+        job.failed = true;
+    }
+    if (g_format == FORMAT_DELTA && !delta.close()) {
+        std::cerr << "Error: Failed to write delta stream file: " << DELTA_FILENAME << std::endl;
+        job.failed = true;
+    }
+    if (job.failed) {
+        return 1;
+    }
+    
+    std::cout << "Done! Generated " << job.frames_total << " frames" << std::endl;
+    if (job.frames_total == 0) {
+        return 0;
+    }
+    std::cout << "Iterated samples: " << job.samples << " ("
+              << std::fixed << std::setprecision(1)
+              << (100.0 * job.samples / (static_cast<double>(g_config.width) * g_config.height * job.frames_total))
+              << "% of a full render)" << std::endl;
+    if (g_subdivide) {
+        std::cout << "Subdivision skipped: " << job.skipped << " pixels ("
+                  << (100.0 * job.skipped / (job.samples + job.skipped)) << "% of sampled pixels)" << std::endl;
+    }
+    std::cout << "Kernel iterations: " << job.iterations << std::endl;
+    if (g_shortcuts) {
+        std::cout << "Iterations saved by shortcuts: " << job.saved
+                  << " (" << (job.saved / job.frames_total) << " per frame; "
+                  << job.interior << " cardioid/bulb points, "
+                  << job.periodic << " periodic orbits)" << std::endl;
+    }
+    if (g_aa != AA_OFF) {
+        // Compared against supersampling every pixel of every rendered frame or keyframe
+        std::cout << "Anti-aliasing: " << job.aa_pixels << " edge pixels supersampled ("
+                  << (100.0 * job.aa_pixels / job.pixels) << "% of rendered pixels), "
+                  << job.aa_pixels * g_aa_samples << " extra samples instead of "
+                  << job.pixels * g_aa_samples << " for full " << g_aa_samples << "x supersampling" << std::endl;
+    }
+    if (g_adaptive_iter) {
+        // Frames resampled from a keyframe share its budget
+        int budget_min = g_config.max_iter;
+        int budget_max = 0;
+        long long budget_sum = 0;
+        int budget_count = 0;
+        for (size_t f = 0; f < job.budgets.size(); f++) {
+            if (job.budgets[f] > 0) {
+                budget_min = std::min(budget_min, job.budgets[f]);
+                budget_max = std::max(budget_max, job.budgets[f]);
+                budget_sum += job.budgets[f];
+                budget_count++;
+            }
+        }
+        if (budget_count > 0) {
+            std::cout << "Iteration budget: " << budget_min << " to " << budget_max << " (average "
+                      << (budget_sum / budget_count) << ", cap " << g_config.max_iter << ")" << std::endl;
+        }
+    }
+    if (g_deep_zoom) {
+        std::cout << "Deep zoom frames: " << job.deep_frames
+                  << " (" << job.glitches << " glitched pixels, "
+                  << job.rebases << " orbit rebases)" << std::endl;
+    }
+    
+    // Per-stage timing: a stage that keeps the other one waiting is the bottleneck
+    double render_s = job.render_ns * 1e-9;
+    double render_wait_s = job.render_wait_ns * 1e-9;
+    double encode_s = job.encode_ns * 1e-9;
+    double encode_idle_s = job.encode_idle_ns * 1e-9;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Wall clock: " << run_seconds << " s" << std::endl;
+    std::cout << "Render stage: " << render_s << " s busy, " << render_wait_s
+              << " s blocked on encoders (" << num_threads << " threads)" << std::endl;
+    if (encoder_threads > 0) {
+        std::cout << "Encode stage: " << encode_s << " s busy, " << encode_idle_s
+                  << " s idle (" << encoder_threads << " threads)" << std::endl;
+        std::cout << "Bottleneck: " << (render_wait_s / num_threads > encode_idle_s / encoder_threads ? "encode" : "render") << std::endl;
+    } else {
+        std::cout << "Encode (in render threads): " << encode_s << " s" << std::endl;
+    }
+    if (g_format == FORMAT_PNG) {
+        std::cout << "PNG frames saved to: " << job.frames_dir << "/" << std::endl;
+        std::cout << "\nTo create a video from frames, you can use ffmpeg:" << std::endl;
+        std::cout << "  ffmpeg -framerate 25 -i frames/frame_%04d.png -c:v libx264 -pix_fmt yuv420p mandelbrot_zoom.mp4" << std::endl;
+    } else {
+        long long frame_bytes = c64_frame_size(layout, g_config.width, g_config.height);
+        std::cout << (g_multicolor ? "Multicolor" : "Packed") << " frames: " << frame_bytes
+                  << " bytes each (" << std::setprecision(1) << (g_config.width * g_config.height * 3.0 / frame_bytes)
+                  << "x smaller than RGB)" << std::endl;
+        if (g_format == FORMAT_STREAM) {
+            std::cout << "Frame stream saved to: " << STREAM_FILENAME << std::endl;
+        } else if (g_format == FORMAT_DELTA) {
+            print_delta_report(delta, frame_bytes);
+            std::cout << "Delta stream saved to: " << DELTA_FILENAME
+                      << " (per-frame sizes in " << DELTA_REPORT_FILENAME << ")" << std::endl;
+        } else {
+            std::cout << "Frames saved to: " << job.frames_dir << "/" << std::endl;
+        }
+    }
     
     return 0;
 }
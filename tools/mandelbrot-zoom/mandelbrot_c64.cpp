@@ -0,0 +1,368 @@
+/*
+ * Native C64 output formats for the Mandelbrot generator
+ */
+
+#include "mandelbrot_c64.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Colodore palette by Pepto: https://www.colodore.com/
+const RGB COLODORE_PALETTE_RGB[16] = {
+    {0x00, 0x00, 0x00},  // 0: Black
+    {0xFF, 0xFF, 0xFF},  // 1: White
+    {0x81, 0x33, 0x38},  // 2: Red
+    {0x75, 0xCE, 0xC8},  // 3: Cyan
+    {0x8E, 0x3C, 0x97},  // 4: Purple
+    {0x56, 0xAC, 0x4D},  // 5: Green
+    {0x2E, 0x2C, 0x9B},  // 6: Blue
+    {0xED, 0xF1, 0x71},  // 7: Yellow
+    {0x8E, 0x50, 0x29},  // 8: Orange
+    {0x55, 0x38, 0x00},  // 9: Brown
+    {0xC4, 0x6C, 0x71},  // 10: Light Red
+    {0x4A, 0x4A, 0x4A},  // 11: Dark Grey
+    {0x7B, 0x7B, 0x7B},  // 12: Medium Grey
+    {0xA9, 0xFF, 0x9F},  // 13: Light Green
+    {0x70, 0x6D, 0xEB},  // 14: Light Blue
+    {0xB2, 0xB2, 0xB2},  // 15: Light Grey
+};
+
+static const char STREAM_MAGIC[4] = {'C', '6', '4', 'Z'};
+static const char DELTA_MAGIC[4] = {'C', '6', '4', 'D'};
+static const int STREAM_VERSION = 1;
+static const int STREAM_HEADER_SIZE = 16;
+
+// Delta run codes
+static const int DELTA_MAX_SKIP = 0x7f;
+static const int DELTA_LITERAL = 0x80;
+static const int DELTA_FILL = 0xc0;
+static const int DELTA_MAX_RUN = 0x40;
+
+int c64_frame_size(C64Layout layout, int width, int height) {
+    if (layout == C64_LAYOUT_MULTICOLOR) {
+        return C64_BITMAP_SIZE + 2 * C64_SCREEN_SIZE + 1;
+    }
+    return width * height / 2;
+}
+
+void pack_nibbles(const unsigned char* indices, int count, unsigned char* out) {
+    for (int i = 0; i < count; i += 2) {
+        out[i / 2] = static_cast<unsigned char>((indices[i] << 4) | (indices[i + 1] & 0x0f));
+    }
+}
+
+/**
+ * Squared RGB distance between two palette colors
+ */
+static int color_distance(int a, int b) {
+    int dr = COLODORE_PALETTE_RGB[a].r - COLODORE_PALETTE_RGB[b].r;
+    int dg = COLODORE_PALETTE_RGB[a].g - COLODORE_PALETTE_RGB[b].g;
+    int db = COLODORE_PALETTE_RGB[a].b - COLODORE_PALETTE_RGB[b].b;
+    return dr * dr + dg * dg + db * db;
+}
+
+void convert_multicolor(const unsigned char* indices, unsigned char* out) {
+    const int width = C64_COLUMNS * 8;
+    unsigned char* bitmap = out;
+    unsigned char* screen = out + C64_BITMAP_SIZE;
+    unsigned char* color_ram = screen + C64_SCREEN_SIZE;
+    unsigned char* background = color_ram + C64_SCREEN_SIZE;
+
+    // Background: most common color of the frame (left pixel of each pair)
+    int frame_count[16] = {0};
+    for (int i = 0; i < width * C64_ROWS * 8; i += 2) {
+        frame_count[indices[i] & 0x0f]++;
+    }
+    int bg = 0;
+    for (int c = 1; c < 16; c++) {
+        if (frame_count[c] > frame_count[bg]) {
+            bg = c;
+        }
+    }
+    *background = static_cast<unsigned char>(bg);
+
+    for (int cy = 0; cy < C64_ROWS; cy++) {
+        for (int cx = 0; cx < C64_COLUMNS; cx++) {
+            const unsigned char* cell = indices + cy * 8 * width + cx * 8;
+
+            // Three most common colors besides the background
+            int count[16] = {0};
+            for (int row = 0; row < 8; row++) {
+                for (int x = 0; x < 8; x += 2) {
+                    count[cell[row * width + x] & 0x0f]++;
+                }
+            }
+            count[bg] = 0;
+
+            int colors[4] = {bg, -1, -1, -1};
+            for (int slot = 1; slot < 4; slot++) {
+                int best = -1;
+                for (int c = 0; c < 16; c++) {
+                    if (count[c] > 0 && (best < 0 || count[c] > count[best])) {
+                        best = c;
+                    }
+                }
+                if (best < 0) {
+                    break;
+                }
+                colors[slot] = best;
+                count[best] = 0;
+            }
+
+            // Bit pair for every palette color: exact match or closest cell color
+            int pair[16];
+            for (int c = 0; c < 16; c++) {
+                int best_slot = 0;
+                for (int slot = 1; slot < 4; slot++) {
+                    if (colors[slot] >= 0 &&
+                        color_distance(c, colors[slot]) < color_distance(c, colors[best_slot])) {
+                        best_slot = slot;
+                    }
+                }
+                pair[c] = best_slot;
+            }
+
+            int cell_index = cy * C64_COLUMNS + cx;
+            for (int row = 0; row < 8; row++) {
+                unsigned char bits = 0;
+                for (int x = 0; x < 8; x += 2) {
+                    bits = static_cast<unsigned char>((bits << 2) | pair[cell[row * width + x] & 0x0f]);
+                }
+                bitmap[cell_index * 8 + row] = bits;
+            }
+
+            // 01 = screen RAM high nibble, 10 = low nibble, 11 = color RAM
+            int c1 = colors[1] < 0 ? 0 : colors[1];
+            int c2 = colors[2] < 0 ? 0 : colors[2];
+            int c3 = colors[3] < 0 ? 0 : colors[3];
+            screen[cell_index] = static_cast<unsigned char>((c1 << 4) | c2);
+            color_ram[cell_index] = static_cast<unsigned char>(c3);
+        }
+    }
+}
+
+int encode_delta(const unsigned char* previous, const unsigned char* current, int size,
+                 std::vector<unsigned char>* out) {
+    int changed = 0;
+    int i = 0;
+
+    while (i < size) {
+        // Unchanged bytes; a single one is cheaper inside a literal run
+        int j = i;
+        while (j < size && current[j] == previous[j]) {
+            j++;
+        }
+        if (j == size) {
+            break;
+        }
+        if (j - i >= 2) {
+            for (; i < j; i += std::min(j - i, DELTA_MAX_SKIP)) {
+                out->push_back(static_cast<unsigned char>(std::min(j - i, DELTA_MAX_SKIP)));
+            }
+            continue;
+        }
+
+        // Runs of one value
+        j = i;
+        while (j < size && j - i < DELTA_MAX_RUN && current[j] == current[i]) {
+            j++;
+        }
+        if (j - i >= 3) {
+            out->push_back(static_cast<unsigned char>(DELTA_FILL | (j - i - 1)));
+            out->push_back(current[i]);
+            for (int k = i; k < j; k++) {
+                changed += current[k] != previous[k];
+            }
+            i = j;
+            continue;
+        }
+
+        // Literal bytes up to the next skip or fill run
+        j = i + 1;
+        while (j < size && j - i < DELTA_MAX_RUN) {
+            if (j + 1 < size && current[j] == previous[j] && current[j + 1] == previous[j + 1]) {
+                break;
+            }
+            if (j + 2 < size && current[j] == current[j + 1] && current[j] == current[j + 2]) {
+                break;
+            }
+            j++;
+        }
+        out->push_back(static_cast<unsigned char>(DELTA_LITERAL | (j - i - 1)));
+        for (int k = i; k < j; k++) {
+            out->push_back(current[k]);
+            changed += current[k] != previous[k];
+        }
+        i = j;
+    }
+
+    out->push_back(0x00);
+    return changed;
+}
+
+int decode_delta(const unsigned char* codes, int length, unsigned char* frame, int size) {
+    int pos = 0;
+    int i = 0;
+
+    while (i < length) {
+        int code = codes[i++];
+        if (code == 0x00) {
+            return i;
+        }
+        if (code < DELTA_LITERAL) {
+            pos += code;
+        } else if (code < DELTA_FILL) {
+            int n = (code & 0x3f) + 1;
+            if (pos + n > size || i + n > length) {
+                return -1;
+            }
+            std::memcpy(frame + pos, codes + i, n);
+            pos += n;
+            i += n;
+        } else {
+            int n = (code & 0x3f) + 1;
+            if (pos + n > size || i >= length) {
+                return -1;
+            }
+            std::memset(frame + pos, codes[i++], n);
+            pos += n;
+        }
+        if (pos > size) {
+            return -1;
+        }
+    }
+
+    return -1;  // missing end code
+}
+
+/**
+ * Write the 16 byte stream header
+ */
+static bool write_stream_header(FILE* fp, const char* magic, C64Layout layout,
+                                int width, int height, int frames, int record_size) {
+    unsigned char header[STREAM_HEADER_SIZE];
+    std::memcpy(header, magic, 4);
+    header[4] = STREAM_VERSION;
+    header[5] = static_cast<unsigned char>(layout);
+    header[6] = width & 0xff;
+    header[7] = (width >> 8) & 0xff;
+    header[8] = height & 0xff;
+    header[9] = (height >> 8) & 0xff;
+    header[10] = frames & 0xff;
+    header[11] = (frames >> 8) & 0xff;
+    for (int k = 0; k < 4; k++) {
+        header[12 + k] = (record_size >> (8 * k)) & 0xff;
+    }
+
+    return fwrite(header, 1, STREAM_HEADER_SIZE, fp) == STREAM_HEADER_SIZE;
+}
+
+FrameStreamWriter::FrameStreamWriter() : fp_(NULL), record_size_(0) {
+}
+
+FrameStreamWriter::~FrameStreamWriter() {
+    close();
+}
+
+bool FrameStreamWriter::open(const std::string& filename, C64Layout layout, int width, int height, int frames) {
+    fp_ = fopen(filename.c_str(), "wb");
+    if (!fp_) {
+        return false;
+    }
+    record_size_ = c64_frame_size(layout, width, height);
+
+    return write_stream_header(fp_, STREAM_MAGIC, layout, width, height, frames, record_size_);
+}
+
+bool FrameStreamWriter::write_frame(int frame, const unsigned char* data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    long offset = STREAM_HEADER_SIZE + static_cast<long>(frame) * record_size_;
+    if (fseek(fp_, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    return fwrite(data, 1, record_size_, fp_) == static_cast<size_t>(record_size_);
+}
+
+bool FrameStreamWriter::close() {
+    if (!fp_) {
+        return true;
+    }
+    bool ok = fclose(fp_) == 0;
+    fp_ = NULL;
+    return ok;
+}
+
+DeltaStreamWriter::DeltaStreamWriter() : fp_(NULL), record_size_(0), next_frame_(0), failed_(false) {
+}
+
+DeltaStreamWriter::~DeltaStreamWriter() {
+    if (fp_) {
+        fclose(fp_);
+    }
+}
+
+bool DeltaStreamWriter::open(const std::string& filename, C64Layout layout, int width, int height, int frames) {
+    fp_ = fopen(filename.c_str(), "wb");
+    if (!fp_) {
+        return false;
+    }
+    record_size_ = c64_frame_size(layout, width, height);
+    previous_.assign(record_size_, 0);
+    frame_bytes_.reserve(frames);
+    changed_bytes_.reserve(frames);
+
+    return write_stream_header(fp_, DELTA_MAGIC, layout, width, height, frames, record_size_);
+}
+
+bool DeltaStreamWriter::write_frame(int frame, const unsigned char* data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_) {
+        return false;
+    }
+
+    if (frame != next_frame_) {
+        pending_[frame].assign(data, data + record_size_);
+        return true;
+    }
+
+    // Write this frame and every held back frame that follows it
+    bool ok = write_delta(frame, data);
+    std::map<int, std::vector<unsigned char> >::iterator it;
+    while (ok && (it = pending_.find(next_frame_)) != pending_.end()) {
+        ok = write_delta(it->first, it->second.data());
+        pending_.erase(it);
+    }
+    failed_ = !ok;
+
+    return ok;
+}
+
+bool DeltaStreamWriter::write_delta(int frame, const unsigned char* data) {
+    codes_.clear();
+    int changed = encode_delta(previous_.data(), data, record_size_, &codes_);
+    int length = static_cast<int>(codes_.size());
+
+    unsigned char prefix[2] = {
+        static_cast<unsigned char>(length & 0xff),
+        static_cast<unsigned char>(length >> 8),
+    };
+    if (fwrite(prefix, 1, 2, fp_) != 2 || fwrite(codes_.data(), 1, length, fp_) != codes_.size()) {
+        return false;
+    }
+
+    std::memcpy(previous_.data(), data, record_size_);
+    frame_bytes_.push_back(length + 2);
+    changed_bytes_.push_back(changed);
+    next_frame_ = frame + 1;
+
+    return true;
+}
+
+bool DeltaStreamWriter::close() {
+    if (!fp_) {
+        return true;
+    }
+    bool ok = fclose(fp_) == 0 && !failed_ && pending_.empty();
+    fp_ = NULL;
+    return ok;
+}
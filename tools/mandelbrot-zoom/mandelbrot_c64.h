@@ -0,0 +1,180 @@
+/*
+ * Native C64 output formats for the Mandelbrot generator
+ *
+ * Frames are kept as Colodore palette indices (one byte per pixel) and
+ * written without expanding them to RGB:
+ *
+ *   packed:     4 bits per pixel, two pixels per byte (left pixel in the
+ *               high nibble), rows top to bottom - 32000 bytes per frame
+ *   multicolor: C64 multicolor bitmap mode (160x200, double-width pixels)
+ *               as bitmap (8000 bytes), screen RAM (1000), color RAM (1000)
+ *               and background color (1) - the Koala Painter layout
+ *
+ * A frame stream holds all frames of a run in one file: a 16 byte header
+ * followed by fixed-size frame records, so frame n starts at
+ * 16 + n * record_size and frames can be written in any order.
+ *
+ *   offset  size  field
+ *   0       4     magic "C64Z"
+ *   4       1     version (1)
+ *   5       1     layout (0 = packed, 1 = multicolor)
+ *   6       2     width (little endian)
+ *   8       2     height
+ *   10      2     frame count
+ *   12      4     record size in bytes
+ *
+ * A delta stream ("C64D", same header) stores every frame as the changes
+ * against the previous frame (the first frame against all zero bytes).
+ * Each frame is a 2 byte little endian length followed by that many bytes
+ * of byte-oriented run codes over the frame record:
+ *
+ *   $00         end of frame, the rest is unchanged
+ *   $01-$7f     skip n unchanged bytes
+ *   $80-$bf     copy the next (n & $3f) + 1 literal bytes
+ *   $c0-$ff     fill (n & $3f) + 1 bytes with the next byte
+ *
+ * In multicolor layout the bitmap is stored cell by cell, so an unchanged
+ * 8x8 cell is a single skip run.
+ */
+
+#ifndef MANDELBROT_C64_H
+#define MANDELBROT_C64_H
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct RGB {
+    unsigned char r, g, b;
+};
+
+// Colodore palette - a more accurate C64 color palette
+extern const RGB COLODORE_PALETTE_RGB[16];
+
+// C64 multicolor bitmap geometry (320x200 hi-res pixels, 40x25 cells)
+const int C64_COLUMNS = 40;
+const int C64_ROWS = 25;
+const int C64_BITMAP_SIZE = C64_COLUMNS * C64_ROWS * 8;
+const int C64_SCREEN_SIZE = C64_COLUMNS * C64_ROWS;
+
+// Koala Painter files start with this load address
+const int KOALA_LOAD_ADDRESS = 0x6000;
+
+enum C64Layout {
+    C64_LAYOUT_PACKED = 0,
+    C64_LAYOUT_MULTICOLOR = 1,
+};
+
+/**
+ * Bytes per frame of a layout
+ */
+int c64_frame_size(C64Layout layout, int width, int height);
+
+/**
+ * Pack palette indices into 4 bits per pixel
+ * count must be even; out receives count / 2 bytes.
+ */
+void pack_nibbles(const unsigned char* indices, int count, unsigned char* out);
+
+/**
+ * Convert a 320x200 frame of palette indices to C64 multicolor layout
+ * out receives bitmap, screen RAM, color RAM and background color
+ * (C64_BITMAP_SIZE + 2 * C64_SCREEN_SIZE + 1 bytes).
+ *
+ * Each multicolor pixel takes the left one of its two hi-res pixels.
+ * The most common color of the frame becomes the background; every cell
+ * gets its three most common remaining colors, and pixels of any other
+ * color are mapped to the closest of the four (Colodore RGB distance).
+ */
+void convert_multicolor(const unsigned char* indices, unsigned char* out);
+
+/**
+ * Delta-encode a frame record against the previous one
+ * Appends the run codes (without the length prefix) to out and returns
+ * the number of changed bytes.
+ */
+int encode_delta(const unsigned char* previous, const unsigned char* current, int size,
+                 std::vector<unsigned char>* out);
+
+/**
+ * Apply the run codes of one frame to the previous frame record in place
+ * Returns the number of code bytes consumed, or -1 for malformed data.
+ */
+int decode_delta(const unsigned char* codes, int length, unsigned char* frame, int size);
+
+/**
+ * Writer for the frame stream container
+ * write_frame() may be called from several threads in any frame order.
+ */
+class FrameStreamWriter {
+public:
+    FrameStreamWriter();
+    ~FrameStreamWriter();
+
+    bool open(const std::string& filename, C64Layout layout, int width, int height, int frames);
+    bool write_frame(int frame, const unsigned char* data);
+    bool close();
+
+    int record_size() const {
+        return record_size_;
+    }
+
+private:
+    // Not copyable
+    FrameStreamWriter(const FrameStreamWriter&);
+    FrameStreamWriter& operator=(const FrameStreamWriter&);
+
+    FILE* fp_;
+    int record_size_;
+    std::mutex mutex_;
+};
+
+/**
+ * Writer for the delta stream
+ * Frames may arrive from several threads in any order; they are held back
+ * until all earlier frames have been written, since every delta refers to
+ * the previous frame.
+ */
+class DeltaStreamWriter {
+public:
+    DeltaStreamWriter();
+    ~DeltaStreamWriter();
+
+    bool open(const std::string& filename, C64Layout layout, int width, int height, int frames);
+    bool write_frame(int frame, const unsigned char* data);
+    bool close();   // fails if frames are missing
+
+    int record_size() const {
+        return record_size_;
+    }
+
+    // Per-frame report: stored bytes (including the length) and changed bytes
+    const std::vector<int>& frame_bytes() const {
+        return frame_bytes_;
+    }
+    const std::vector<int>& changed_bytes() const {
+        return changed_bytes_;
+    }
+
+private:
+    // Not copyable
+    DeltaStreamWriter(const DeltaStreamWriter&);
+    DeltaStreamWriter& operator=(const DeltaStreamWriter&);
+
+    bool write_delta(int frame, const unsigned char* data);
+
+    FILE* fp_;
+    int record_size_;
+    int next_frame_;
+    bool failed_;
+    std::vector<unsigned char> previous_;
+    std::vector<unsigned char> codes_;
+    std::map<int, std::vector<unsigned char> > pending_;
+    std::vector<int> frame_bytes_;
+    std::vector<int> changed_bytes_;
+    std::mutex mutex_;
+};
+
+#endif
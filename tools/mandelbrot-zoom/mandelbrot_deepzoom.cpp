@@ -0,0 +1,201 @@
+/*
+ * Perturbation-theory deep zoom for the Mandelbrot generator
+ */
+
+#include "mandelbrot_deepzoom.h"
+
+#include <cmath>
+
+BigFixed::BigFixed() : negative(false) {
+    for (int k = 0; k < BIGFIXED_LIMBS; k++) {
+        limb[k] = 0;
+    }
+}
+
+BigFixed::BigFixed(double value) : negative(value < 0.0) {
+    // Peel off 32 bits at a time; every step is exact for a double
+    double a = std::fabs(value);
+    for (int k = 0; k < BIGFIXED_LIMBS; k++) {
+        double digit = std::floor(a);
+        limb[k] = static_cast<uint32_t>(digit);
+        a = (a - digit) * 4294967296.0;
+    }
+}
+
+double BigFixed::to_double() const {
+    // Accumulate from the least significant limb to keep rounding minimal
+    double value = 0.0;
+    for (int k = BIGFIXED_LIMBS - 1; k >= 0; k--) {
+        value = value / 4294967296.0 + limb[k];
+    }
+    return negative ? -value : value;
+}
+
+/**
+ * Compare magnitudes: returns -1, 0 or 1
+ */
+static int compare_magnitude(const BigFixed& a, const BigFixed& b) {
+    for (int k = 0; k < BIGFIXED_LIMBS; k++) {
+        if (a.limb[k] != b.limb[k]) {
+            return a.limb[k] < b.limb[k] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * |a| + |b|
+ */
+static void add_magnitude(const BigFixed& a, const BigFixed& b, BigFixed& result) {
+    uint64_t carry = 0;
+    for (int k = BIGFIXED_LIMBS - 1; k >= 0; k--) {
+        uint64_t sum = static_cast<uint64_t>(a.limb[k]) + b.limb[k] + carry;
+        result.limb[k] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+}
+
+/**
+ * |a| - |b|, requires |a| >= |b|
+ */
+static void sub_magnitude(const BigFixed& a, const BigFixed& b, BigFixed& result) {
+    int64_t borrow = 0;
+    for (int k = BIGFIXED_LIMBS - 1; k >= 0; k--) {
+        int64_t diff = static_cast<int64_t>(a.limb[k]) - b.limb[k] - borrow;
+        borrow = diff < 0 ? 1 : 0;
+        result.limb[k] = static_cast<uint32_t>(diff + (borrow << 32));
+    }
+}
+
+/**
+ * Signed addition of a and (negate_b ? -b : b)
+ */
+static BigFixed add_signed(const BigFixed& a, const BigFixed& b, bool negate_b) {
+    BigFixed result;
+    bool b_negative = negate_b ? !b.negative : b.negative;
+
+    if (a.negative == b_negative) {
+        add_magnitude(a, b, result);
+        result.negative = a.negative;
+    } else if (compare_magnitude(a, b) >= 0) {
+        sub_magnitude(a, b, result);
+        result.negative = a.negative;
+    } else {
+        sub_magnitude(b, a, result);
+        result.negative = b_negative;
+    }
+
+    return result;
+}
+
+BigFixed operator+(const BigFixed& a, const BigFixed& b) {
+    return add_signed(a, b, false);
+}
+
+BigFixed operator-(const BigFixed& a, const BigFixed& b) {
+    return add_signed(a, b, true);
+}
+
+BigFixed operator*(const BigFixed& a, const BigFixed& b) {
+    // Schoolbook multiplication; the product has 2 * (LIMBS - 1) fraction
+    // limbs, keep the integer limb and the LIMBS - 1 most significant ones
+    const int N = BIGFIXED_LIMBS;
+    uint32_t product[2 * N] = {0};
+
+    for (int i = N - 1; i >= 0; i--) {
+        uint64_t carry = 0;
+        for (int j = N - 1; j >= 0; j--) {
+            uint64_t t = static_cast<uint64_t>(a.limb[i]) * b.limb[j] + product[i + j + 1] + carry;
+            product[i + j + 1] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        product[i] = static_cast<uint32_t>(carry);
+    }
+
+    BigFixed result;
+    for (int k = 0; k < N; k++) {
+        result.limb[k] = product[k + 1];
+    }
+    result.negative = a.negative != b.negative;
+
+    return result;
+}
+
+void ReferenceOrbit::compute(const BigFixed& c_real, const BigFixed& c_imag, int max_iter) {
+    z_real.clear();
+    z_imag.clear();
+    z_real.reserve(max_iter + 1);
+    z_imag.reserve(max_iter + 1);
+
+    BigFixed zr;
+    BigFixed zi;
+
+    for (int n = 0; n <= max_iter; n++) {
+        double zr_d = zr.to_double();
+        double zi_d = zi.to_double();
+        z_real.push_back(zr_d);
+        z_imag.push_back(zi_d);
+
+        // Stop once the reference escapes; rebasing covers the remainder
+        if (zr_d * zr_d + zi_d * zi_d > 4.0) {
+            break;
+        }
+
+        // Z = Z^2 + C
+        BigFixed zr2 = zr * zr;
+        BigFixed zi2 = zi * zi;
+        BigFixed zri = zr * zi;
+        zr = zr2 - zi2 + c_real;
+        zi = zri + zri + c_imag;
+    }
+}
+
+int mandelbrot_perturbed(const ReferenceOrbit& ref, double dc_real, double dc_imag,
+                         int max_iter, float* norm, PerturbationStats* stats) {
+    const int last = static_cast<int>(ref.z_real.size()) - 1;
+    double dz_real = 0.0;
+    double dz_imag = 0.0;
+    bool glitched = false;
+    int m = 0;
+
+    for (int i = 0; i < max_iter; i++) {
+        double Z_real = ref.z_real[m];
+        double Z_imag = ref.z_imag[m];
+        double z_real = Z_real + dz_real;
+        double z_imag = Z_imag + dz_imag;
+        double mag = z_real * z_real + z_imag * z_imag;
+
+        // Check if we've escaped (|z| > 2)
+        if (mag > 4.0) {
+            *norm = static_cast<float>(mag);
+            return i;
+        }
+
+        // Pauldelbrot glitch criterion: the delta dominates the full value
+        if (!glitched && mag < 1e-6 * (Z_real * Z_real + Z_imag * Z_imag)) {
+            glitched = true;
+            stats->glitches++;
+        }
+
+        // Rebase onto the start of the reference before precision is lost
+        if (mag < dz_real * dz_real + dz_imag * dz_imag || m == last) {
+            dz_real = z_real;
+            dz_imag = z_imag;
+            Z_real = 0.0;
+            Z_imag = 0.0;
+            m = 0;
+            stats->rebases++;
+        }
+
+        // dz = (2 * Z + dz) * dz + dc
+        double t_real = 2.0 * Z_real + dz_real;
+        double t_imag = 2.0 * Z_imag + dz_imag;
+        double dz_real_new = t_real * dz_real - t_imag * dz_imag + dc_real;
+        dz_imag = t_real * dz_imag + t_imag * dz_real + dc_imag;
+        dz_real = dz_real_new;
+        m++;
+    }
+
+    *norm = 0.0f;
+    return max_iter;
+}
@@ -0,0 +1,73 @@
+/*
+ * Perturbation-theory deep zoom for the Mandelbrot generator
+ *
+ * One reference orbit Z_n is iterated in high precision at the zoom center.
+ * Every pixel c = C + dc is then iterated in plain doubles as a delta
+ * dz_n = z_n - Z_n:
+ *
+ *   dz_{n+1} = 2 * Z_n * dz_n + dz_n^2 + dc
+ *
+ * Deltas stay tiny relative to the view, so double precision is enough
+ * even at zoom levels far beyond 1e13 where c itself cannot be represented.
+ */
+
+#ifndef MANDELBROT_DEEPZOOM_H
+#define MANDELBROT_DEEPZOOM_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Signed fixed-point number with 32-bit limbs
+ * limb[0] holds the integer part, limb[1..] the fraction, giving
+ * 32 * (BIGFIXED_LIMBS - 1) fraction bits (224 bits by default,
+ * enough for zoom levels around 1e50).
+ */
+const int BIGFIXED_LIMBS = 8;
+
+struct BigFixed {
+    bool negative;
+    uint32_t limb[BIGFIXED_LIMBS];
+
+    BigFixed();
+    explicit BigFixed(double value);
+
+    double to_double() const;
+};
+
+BigFixed operator+(const BigFixed& a, const BigFixed& b);
+BigFixed operator-(const BigFixed& a, const BigFixed& b);
+BigFixed operator*(const BigFixed& a, const BigFixed& b);
+
+/**
+ * Reference orbit Z_0 .. Z_n at the zoom center, rounded to double
+ * The orbit ends early if the reference point escapes.
+ */
+struct ReferenceOrbit {
+    std::vector<double> z_real;
+    std::vector<double> z_imag;
+
+    void compute(const BigFixed& c_real, const BigFixed& c_imag, int max_iter);
+};
+
+/**
+ * Counters for glitch handling of one frame
+ */
+struct PerturbationStats {
+    long long rebases;      // orbit rebased to the start of the reference
+    long long glitches;     // pixels where |z| dropped far below |Z| (Pauldelbrot criterion)
+};
+
+/**
+ * Iterate one pixel at offset (dc_real, dc_imag) from the reference point
+ * Returns number of iterations before escape (or max_iter if it doesn't escape)
+ * and stores |z|^2 at escape in *norm (0 if it doesn't escape).
+ *
+ * Glitches are avoided by rebasing: whenever |z| becomes smaller than |dz|
+ * or the reference orbit runs out, the full value z becomes the new delta
+ * against Z_0 = 0 and iteration continues at the start of the reference.
+ */
+int mandelbrot_perturbed(const ReferenceOrbit& ref, double dc_real, double dc_imag,
+                         int max_iter, float* norm, PerturbationStats* stats);
+
+#endif
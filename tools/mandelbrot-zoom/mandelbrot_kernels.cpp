@@ -0,0 +1,476 @@
+/*
+ * Mandelbrot escape-time kernels
+ *
+ * The vector kernels keep one (z_real, z_imag) pair per lane and iterate all
+ * lanes in lockstep. A lane mask tracks which points have not escaped yet;
+ * the loop ends as soon as every lane has escaped or max_iter is reached.
+ *
+ * To stay bit-identical with the scalar path, every lane performs exactly
+ * the same IEEE double operations in the same order as mandelbrot():
+ *   escape test: z_real * z_real + z_imag * z_imag > 4.0
+ *   update:      z_real * z_real - z_imag * z_imag + c_real
+ *                (2.0 * z_real) * z_imag + c_imag
+ * No FMA instructions may be used, since fused rounding would change results.
+ * GCC contracts mul+add intrinsics into FMA when the target has FMA (AVX-512
+ * does), so this file must be compiled with -ffp-contract=off.
+ *
+ * Shortcuts never change results: interior points of the cardioid and
+ * period-2 bulb provably never escape, and periodicity detection only
+ * triggers on an exact (bit-identical) repeat of z, after which the
+ * deterministic iteration would cycle forever without escaping.
+ */
+
+#include "mandelbrot_kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MANDELBROT_X86 1
+#include <immintrin.h>
+#endif
+
+int mandelbrot(double c_real, double c_imag, int max_iter) {
+    double z_real = 0.0;
+    double z_imag = 0.0;
+
+    for (int i = 0; i < max_iter; i++) {
+        // Check if we've escaped (|z| > 2)
+        if (z_real * z_real + z_imag * z_imag > 4.0) {
+            return i;
+        }
+
+        // z = z^2 + c
+        double z_real_new = z_real * z_real - z_imag * z_imag + c_real;
+        z_imag = 2.0 * z_real * z_imag + c_imag;
+        z_real = z_real_new;
+    }
+
+    return max_iter;
+}
+
+bool in_cardioid_or_bulb(double c_real, double c_imag) {
+    // Main cardioid: q * (q + (x - 1/4)) <= y^2 / 4 with q = (x - 1/4)^2 + y^2
+    double x = c_real - 0.25;
+    double y2 = c_imag * c_imag;
+    double q = x * x + y2;
+    if (q * (q + x) <= 0.25 * y2) {
+        return true;
+    }
+
+    // Period-2 bulb: circle of radius 1/4 around -1
+    double x1 = c_real + 1.0;
+    return x1 * x1 + y2 <= 0.0625;
+}
+
+/**
+ * Scalar iterator with optional Brent periodicity detection
+ * z is saved at iterations 1, 2, 4, 8, ...; returning to the saved value
+ * bit-for-bit means the orbit is periodic and never escapes.
+ */
+static int mandelbrot_iterate(double c_real, double c_imag, int max_iter,
+                              bool periodicity, float* norm, KernelStats* stats) {
+    double z_real = 0.0;
+    double z_imag = 0.0;
+    double saved_real = 0.0;
+    double saved_imag = 0.0;
+    int next_save = 1;
+
+    *norm = 0.0f;
+
+    for (int i = 0; i < max_iter; i++) {
+        // Check if we've escaped (|z| > 2)
+        double mag = z_real * z_real + z_imag * z_imag;
+        if (mag > 4.0) {
+            *norm = static_cast<float>(mag);
+            stats->iterations += i;
+            return i;
+        }
+
+        // z = z^2 + c
+        double z_real_new = z_real * z_real - z_imag * z_imag + c_real;
+        z_imag = 2.0 * z_real * z_imag + c_imag;
+        z_real = z_real_new;
+
+        if (periodicity) {
+            if (z_real == saved_real && z_imag == saved_imag) {
+                stats->iterations += i + 1;
+                stats->periodic++;
+                stats->saved += max_iter - (i + 1);
+                return max_iter;
+            }
+            if (i + 1 == next_save) {
+                saved_real = z_real;
+                saved_imag = z_imag;
+                next_save *= 2;
+            }
+        }
+    }
+
+    stats->iterations += max_iter;
+    return max_iter;
+}
+
+/**
+ * Scalar batch kernel - one point at a time
+ */
+static void iterate_scalar(const double* c_real, const double* c_imag, int count,
+                           int max_iter, bool periodicity, int* iterations, float* norms,
+                           KernelStats* stats) {
+    float norm;
+    for (int i = 0; i < count; i++) {
+        iterations[i] = mandelbrot_iterate(c_real[i], c_imag[i], max_iter, periodicity,
+                                           norms ? norms + i : &norm, stats);
+    }
+}
+
+/**
+ * Iteration core of a batch kernel (shortcuts: periodicity detection only)
+ */
+typedef void (*IterateFunction)(const double* c_real, const double* c_imag, int count,
+                                int max_iter, bool periodicity, int* iterations, float* norms,
+                                KernelStats* stats);
+
+/**
+ * Batch kernel front-end: with shortcuts, interior points are resolved
+ * up front and only the remaining points are packed into the lanes of
+ * the iteration core, so vector lanes are not wasted on them
+ */
+template <IterateFunction ITERATE>
+static void run_kernel(const double* c_real, const double* c_imag, int count, int max_iter,
+                       bool shortcuts, int* iterations, float* norms, KernelStats* stats) {
+    if (!shortcuts) {
+        ITERATE(c_real, c_imag, count, max_iter, false, iterations, norms, stats);
+        return;
+    }
+
+    const int CHUNK = 256;
+    double re[CHUNK], im[CHUNK];
+    int index[CHUNK], result[CHUNK];
+    float result_norms[CHUNK];
+
+    for (int offset = 0; offset < count; offset += CHUNK) {
+        int end = offset + CHUNK < count ? offset + CHUNK : count;
+        int n = 0;
+
+        for (int i = offset; i < end; i++) {
+            if (in_cardioid_or_bulb(c_real[i], c_imag[i])) {
+                iterations[i] = max_iter;
+                if (norms) {
+                    norms[i] = 0.0f;
+                }
+                stats->interior++;
+                stats->saved += max_iter;
+            } else {
+                re[n] = c_real[i];
+                im[n] = c_imag[i];
+                index[n++] = i;
+            }
+        }
+
+        if (n > 0) {
+            ITERATE(re, im, n, max_iter, true, result, norms ? result_norms : NULL, stats);
+            for (int k = 0; k < n; k++) {
+                iterations[index[k]] = result[k];
+            }
+            if (norms) {
+                for (int k = 0; k < n; k++) {
+                    norms[index[k]] = result_norms[k];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Load up to LANES points starting at offset, padding a partial batch
+ * with copies of the last point so all lanes hold valid coordinates
+ */
+template <int LANES>
+static inline int load_batch(const double* c_real, const double* c_imag,
+                             int offset, int count, double* re, double* im) {
+    int n = count - offset;
+    if (n > LANES) n = LANES;
+    for (int l = 0; l < LANES; l++) {
+        int src = offset + (l < n ? l : n - 1);
+        re[l] = c_real[src];
+        im[l] = c_imag[src];
+    }
+    return n;
+}
+
+/**
+ * Store the per-lane results of a batch: lanes stopped by periodicity
+ * detection report max_iter, all others their escape iteration and,
+ * if requested, |z|^2 at escape (0 for points that did not escape)
+ */
+template <int LANES>
+static inline void store_batch(const double* iter, const double* escaped, int periodic_mask,
+                               int n, int max_iter, int* iterations, float* norms,
+                               KernelStats* stats) {
+    for (int l = 0; l < n; l++) {
+        int performed = static_cast<int>(iter[l]);
+        stats->iterations += performed;
+        if (periodic_mask & (1 << l)) {
+            iterations[l] = max_iter;
+            stats->periodic++;
+            stats->saved += max_iter - performed;
+        } else {
+            iterations[l] = performed;
+        }
+        if (norms) {
+            norms[l] = iterations[l] < max_iter ? static_cast<float>(escaped[l]) : 0.0f;
+        }
+    }
+}
+
+#ifdef MANDELBROT_X86
+
+/**
+ * SSE2 kernel - 2 points in lockstep (baseline on x86-64)
+ */
+__attribute__((target("sse2")))
+static void iterate_sse2(const double* c_real, const double* c_imag, int count,
+                         int max_iter, bool periodicity, int* iterations, float* norms,
+                         KernelStats* stats) {
+    const __m128d four = _mm_set1_pd(4.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d one = _mm_set1_pd(1.0);
+
+    for (int offset = 0; offset < count; offset += 2) {
+        double re[2], im[2], iter[2], norm[2];
+        int n = load_batch<2>(c_real, c_imag, offset, count, re, im);
+
+        __m128d cr = _mm_loadu_pd(re);
+        __m128d ci = _mm_loadu_pd(im);
+        __m128d zr = _mm_setzero_pd();
+        __m128d zi = _mm_setzero_pd();
+        __m128d sr = _mm_setzero_pd();
+        __m128d si = _mm_setzero_pd();
+        __m128d it = _mm_setzero_pd();
+        __m128d escaped = _mm_setzero_pd();
+        __m128d active = _mm_castsi128_pd(_mm_set1_epi32(-1));
+        int periodic = 0;
+        int next_save = 1;
+
+        for (int i = 0; i < max_iter; i++) {
+            __m128d zr2 = _mm_mul_pd(zr, zr);
+            __m128d zi2 = _mm_mul_pd(zi, zi);
+            __m128d mag = _mm_add_pd(zr2, zi2);
+
+            // Lanes drop out once |z|^2 > 4, keeping |z|^2 for smooth coloring
+            __m128d escaping = _mm_and_pd(_mm_cmpgt_pd(mag, four), active);
+            active = _mm_andnot_pd(escaping, active);
+            if (norms) {
+                escaped = _mm_or_pd(_mm_and_pd(escaping, mag), _mm_andnot_pd(escaping, escaped));
+            }
+            if (_mm_movemask_pd(active) == 0) {
+                break;
+            }
+            it = _mm_add_pd(it, _mm_and_pd(active, one));
+
+            __m128d zr_new = _mm_add_pd(_mm_sub_pd(zr2, zi2), cr);
+            zi = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, zr), zi), ci);
+            zr = zr_new;
+
+            if (periodicity) {
+                // Lanes whose orbit returned to the saved value are periodic
+                __m128d same = _mm_and_pd(_mm_cmpeq_pd(zr, sr), _mm_cmpeq_pd(zi, si));
+                same = _mm_and_pd(same, active);
+                int same_mask = _mm_movemask_pd(same);
+                if (same_mask) {
+                    periodic |= same_mask;
+                    active = _mm_andnot_pd(same, active);
+                }
+                if (i + 1 == next_save) {
+                    sr = zr;
+                    si = zi;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        _mm_storeu_pd(iter, it);
+        _mm_storeu_pd(norm, escaped);
+        store_batch<2>(iter, norm, periodic, n, max_iter, iterations + offset,
+                       norms ? norms + offset : NULL, stats);
+    }
+}
+
+/**
+ * AVX2 kernel - 4 points in lockstep
+ */
+__attribute__((target("avx2")))
+static void iterate_avx2(const double* c_real, const double* c_imag, int count,
+                         int max_iter, bool periodicity, int* iterations, float* norms,
+                         KernelStats* stats) {
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    for (int offset = 0; offset < count; offset += 4) {
+        double re[4], im[4], iter[4], norm[4];
+        int n = load_batch<4>(c_real, c_imag, offset, count, re, im);
+
+        __m256d cr = _mm256_loadu_pd(re);
+        __m256d ci = _mm256_loadu_pd(im);
+        __m256d zr = _mm256_setzero_pd();
+        __m256d zi = _mm256_setzero_pd();
+        __m256d sr = _mm256_setzero_pd();
+        __m256d si = _mm256_setzero_pd();
+        __m256d it = _mm256_setzero_pd();
+        __m256d escaped = _mm256_setzero_pd();
+        __m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        int periodic = 0;
+        int next_save = 1;
+
+        for (int i = 0; i < max_iter; i++) {
+            __m256d zr2 = _mm256_mul_pd(zr, zr);
+            __m256d zi2 = _mm256_mul_pd(zi, zi);
+            __m256d mag = _mm256_add_pd(zr2, zi2);
+
+            // Lanes drop out once |z|^2 > 4, keeping |z|^2 for smooth coloring
+            __m256d escaping = _mm256_and_pd(_mm256_cmp_pd(mag, four, _CMP_GT_OQ), active);
+            active = _mm256_andnot_pd(escaping, active);
+            if (norms) {
+                escaped = _mm256_blendv_pd(escaped, mag, escaping);
+            }
+            if (_mm256_movemask_pd(active) == 0) {
+                break;
+            }
+            it = _mm256_add_pd(it, _mm256_and_pd(active, one));
+
+            __m256d zr_new = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cr);
+            zi = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, zr), zi), ci);
+            zr = zr_new;
+
+            if (periodicity) {
+                // Lanes whose orbit returned to the saved value are periodic
+                __m256d same = _mm256_and_pd(_mm256_cmp_pd(zr, sr, _CMP_EQ_OQ),
+                                             _mm256_cmp_pd(zi, si, _CMP_EQ_OQ));
+                same = _mm256_and_pd(same, active);
+                int same_mask = _mm256_movemask_pd(same);
+                if (same_mask) {
+                    periodic |= same_mask;
+                    active = _mm256_andnot_pd(same, active);
+                }
+                if (i + 1 == next_save) {
+                    sr = zr;
+                    si = zi;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        _mm256_storeu_pd(iter, it);
+        _mm256_storeu_pd(norm, escaped);
+        store_batch<4>(iter, norm, periodic, n, max_iter, iterations + offset,
+                       norms ? norms + offset : NULL, stats);
+    }
+}
+
+/**
+ * AVX-512 kernel - 8 points in lockstep using mask registers
+ */
+__attribute__((target("avx512f")))
+static void iterate_avx512(const double* c_real, const double* c_imag, int count,
+                           int max_iter, bool periodicity, int* iterations, float* norms,
+                           KernelStats* stats) {
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d one = _mm512_set1_pd(1.0);
+
+    for (int offset = 0; offset < count; offset += 8) {
+        double re[8], im[8], iter[8], norm[8];
+        int n = load_batch<8>(c_real, c_imag, offset, count, re, im);
+
+        __m512d cr = _mm512_loadu_pd(re);
+        __m512d ci = _mm512_loadu_pd(im);
+        __m512d zr = _mm512_setzero_pd();
+        __m512d zi = _mm512_setzero_pd();
+        __m512d sr = _mm512_setzero_pd();
+        __m512d si = _mm512_setzero_pd();
+        __m512d it = _mm512_setzero_pd();
+        __m512d escaped = _mm512_setzero_pd();
+        __mmask8 active = 0xFF;
+        __mmask8 periodic = 0;
+        int next_save = 1;
+
+        for (int i = 0; i < max_iter; i++) {
+            __m512d zr2 = _mm512_mul_pd(zr, zr);
+            __m512d zi2 = _mm512_mul_pd(zi, zi);
+            __m512d mag = _mm512_add_pd(zr2, zi2);
+
+            // Lanes drop out once |z|^2 > 4, keeping |z|^2 for smooth coloring
+            __mmask8 still_active = _mm512_mask_cmp_pd_mask(active, mag, four, _CMP_NGT_UQ);
+            if (norms) {
+                escaped = _mm512_mask_mov_pd(escaped, active & ~still_active, mag);
+            }
+            active = still_active;
+            if (active == 0) {
+                break;
+            }
+            it = _mm512_mask_add_pd(it, active, it, one);
+
+            __m512d zr_new = _mm512_add_pd(_mm512_sub_pd(zr2, zi2), cr);
+            zi = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, zr), zi), ci);
+            zr = zr_new;
+
+            if (periodicity) {
+                // Lanes whose orbit returned to the saved value are periodic
+                __mmask8 same = _mm512_mask_cmp_pd_mask(active, zr, sr, _CMP_EQ_OQ);
+                same = _mm512_mask_cmp_pd_mask(same, zi, si, _CMP_EQ_OQ);
+                periodic |= same;
+                active &= ~same;
+                if (i + 1 == next_save) {
+                    sr = zr;
+                    si = zi;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        _mm512_storeu_pd(iter, it);
+        _mm512_storeu_pd(norm, escaped);
+        store_batch<8>(iter, norm, periodic, n, max_iter, iterations + offset,
+                       norms ? norms + offset : NULL, stats);
+    }
+}
+
+#endif
+
+const KernelInfo KERNELS[] = {
+#ifdef MANDELBROT_X86
+    {"avx512", run_kernel<iterate_avx512>, 8},
+    {"avx2", run_kernel<iterate_avx2>, 4},
+    {"sse2", run_kernel<iterate_sse2>, 2},
+#endif
+    {"scalar", run_kernel<iterate_scalar>, 1},
+    {NULL, NULL, 0},
+};
+bool kernel_supported(const KernelInfo& info) {
+#ifdef MANDELBROT_X86
+    __builtin_cpu_init();
+    if (std::strcmp(info.name, "avx512") == 0) return __builtin_cpu_supports("avx512f");
+    if (std::strcmp(info.name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+    if (std::strcmp(info.name, "sse2") == 0) return __builtin_cpu_supports("sse2");
+#endif
+    return true;
+}
+
+const KernelInfo* select_kernel(const char* name) {
+    bool pick_fastest = std::strcmp(name, "auto") == 0;
+
+    for (int i = 0; KERNELS[i].name != NULL; i++) {
+        if (!pick_fastest && std::strcmp(KERNELS[i].name, name) != 0) {
+            continue;
+        }
+        if (kernel_supported(KERNELS[i])) {
+            return &KERNELS[i];
+        }
+        if (!pick_fastest) {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,75 @@
+/*
+ * Mandelbrot escape-time kernels
+ * Scalar reference iterator plus SSE2/AVX2/AVX-512 batch kernels that
+ * iterate several points in lockstep. All kernels produce bit-identical
+ * iteration counts to the scalar mandelbrot() function, with or without
+ * the interior/periodicity shortcuts.
+ */
+
+#ifndef MANDELBROT_KERNELS_H
+#define MANDELBROT_KERNELS_H
+
+/**
+ * Calculate Mandelbrot set membership
+ * Returns number of iterations before escape (or max_iter if it doesn't escape)
+ */
+int mandelbrot(double c_real, double c_imag, int max_iter);
+
+/**
+ * Work counters of a kernel run
+ */
+struct KernelStats {
+    long long iterations;   // z = z^2 + c steps actually performed
+    long long interior;     // points skipped by the cardioid/period-2 bulb test
+    long long periodic;     // points stopped by periodicity detection
+    long long saved;        // iterations saved by both shortcuts
+};
+
+/**
+ * Check whether c lies inside the main cardioid or the period-2 bulb
+ * Such points never escape, so they can skip iteration entirely.
+ */
+bool in_cardioid_or_bulb(double c_real, double c_imag);
+
+/**
+ * Batch kernel: iterate count points (c_real[i], c_imag[i]) and store
+ * the escape iteration of each point in iterations[i]
+ *
+ * If norms is not NULL, norms[i] receives |z|^2 at the escape iteration,
+ * which smooth coloring needs (0 for points that did not escape).
+ *
+ * With shortcuts enabled, interior points of the cardioid and period-2 bulb
+ * are not iterated, and orbits are checked for exact repetition with
+ * Brent's method (comparing against z saved at power-of-two iterations).
+ * An orbit that returns to a bit-identical value is periodic and can never
+ * escape, so the result is exactly max_iter as without the shortcut.
+ */
+typedef void (*MandelbrotKernel)(const double* c_real, const double* c_imag,
+                                 int count, int max_iter, bool shortcuts,
+                                 int* iterations, float* norms, KernelStats* stats);
+
+struct KernelInfo {
+    const char* name;
+    MandelbrotKernel kernel;
+    int lanes;              // points iterated in lockstep
+};
+
+/**
+ * All kernels compiled into this binary, fastest first
+ * Terminated by an entry with name == NULL.
+ */
+extern const KernelInfo KERNELS[];
+
+/**
+ * Check whether the running CPU can execute the given kernel
+ */
+bool kernel_supported(const KernelInfo& info);
+
+/**
+ * Find a kernel by name ("scalar", "sse2", "avx2", "avx512")
+ * "auto" selects the fastest kernel supported by the running CPU.
+ * Returns NULL for unknown or unsupported kernels.
+ */
+const KernelInfo* select_kernel(const char* name);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Shape Tables - C64 vertex includes of the parametric demo objects
+ *
+ * Writes the objects defined in c64_shapes.h as ACME include files, so the
+ * C64 side uses exactly the vertices the OpenGL demos draw. The tables are
+ * generated while compiling; running the program only writes them out.
+ *
+ * Usage: shape-tables [DIRECTORY]
+ */
+
+#include "c64_shapes.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace shapes;
+
+namespace Tables {
+
+    constexpr auto CUBE_GRID_POINTS = truncated(generate<CUBE_GRID.count()>(CUBE_GRID));
+    constexpr auto HELIX_POINTS = truncated(generate<CYLINDER_HELIX.count()>(CYLINDER_HELIX));
+    constexpr auto ROPE_POINTS = rounded(generate<CYLINDER_ROPE.count()>(CYLINDER_ROPE));
+    constexpr auto DOUBLE_ROPE_POINTS = rounded(generate<DOUBLE_ROPE.count()>(DOUBLE_ROPE));
+    constexpr auto ICOSAHEDRON_POINTS = rounded(generate<ICOSAHEDRON.count()>(ICOSAHEDRON));
+
+    // The morph models are a few units across; 32 keeps them inside a signed byte
+    constexpr float MORPH_SCALE = 32.0f;
+    constexpr auto TORUS_POINTS = scaled(generate<MORPH_TORUS.count()>(MORPH_TORUS), MORPH_SCALE);
+    constexpr auto STAR_POINTS = scaled(generate<MORPH_STAR.count()>(MORPH_STAR), MORPH_SCALE);
+
+}
+
+static int failures = 0;
+
+template <int N>
+static void write(const string& directory, const string& file, const string& label, const string& comment,
+                  const Table<Point3i, N>& table) {
+    string path = directory + "/" + file;
+    if (write_vertex_include(path, label, comment, table)) {
+        cout << path << ": " << N << " vertices" << endl;
+    } else {
+        cerr << "Could not write " << path << " (file error or coordinate outside -128..127)" << endl;
+        failures++;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        cerr << "Usage: " << argv[0] << " [DIRECTORY]" << endl;
+        return 1;
+    }
+    string directory = argc > 1 ? argv[1] : ".";
+
+    write(directory, "cube-grid-data.i", "cube_grid", "Cube grid: 3x3 points on each face", Tables::CUBE_GRID_POINTS);
+    write(directory, "double-helix-data.i", "helix", "Double helix: 2 strands of 16 points, radius 4",
+          Tables::HELIX_POINTS);
+    write(directory, "rope-data.i", "rope", "Rope around a cylinder: radius 8, height 30, 4.5 wraps",
+          Tables::ROPE_POINTS);
+    write(directory, "double-rope-data.i", "double_rope", "Double rope: 2 interleaved strands of 9 points",
+          Tables::DOUBLE_ROPE_POINTS);
+    write(directory, "icosahedron-data.i", "icosahedron", "Icosahedron: golden ratio vertices times 62",
+          Tables::ICOSAHEDRON_POINTS);
+    write(directory, "torus-data.i", "torus", "Morph torus, scaled by 32", Tables::TORUS_POINTS);
+    write(directory, "star-data.i", "star", "Morph star, scaled by 32", Tables::STAR_POINTS);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -1,20 +1,31 @@
 //- OpenGL Three Spheres Display - GL_POINTS Vertex Model
-//- Displays 3 overlapping spheres as a single point-based vertex model
+//- Displays 3 overlapping spheres (or any list of spheres) as a single point-based vertex model
 
 #include <stdlib.h>
+#define GL_GLEXT_PROTOTYPES
 #include <GL/glut.h>
 #include <GL/gl.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include <vector>
 
+#include "c64_headless.h"
+#include "c64_projection.h"
+#include "c64_vertex_file.h"
+
 using namespace std;
 
 // Vertex structure with position and color
 struct Vertex {
     float x, y, z;
     float r, g, b;
-    double screenX, screenY, screenZ;  // Projected screen coordinates (GLdouble for gluProject)
 };
 
 // Sphere properties - positioned to overlap and form a single 3D model
@@ -31,75 +42,209 @@ namespace Spheres {
     const float SPHERE3_RADIUS = 1.4f;
     const float SPHERE3_Y = -1.5f;  // Overlaps with Sphere 2 (extends from -2.9 to -0.1)
     
+    // A sphere of the model
+    struct Sphere {
+        float cx, cy, cz;
+        float radius;
+        float r, g, b;
+        int number;     // name in the banner: SPHERE<number>_* for the defaults, else the file order
+    };
+    
+    // Spheres of the model, generated in this order (back to front)
+    vector<Sphere> spheres;
+    
     vector<Vertex> vertices;
     
-    // Check if a point is inside any sphere
-    bool isInsideSphere(float x, float y, float z, float sx, float sy, float sz, float radius) {
-        float dx = x - sx;
-        float dy = y - sy;
-        float dz = z - sz;
-        return (dx*dx + dy*dy + dz*dz) <= (radius*radius);
-    }
-    
-    // Check if a point is occluded by another sphere (from camera viewpoint)
-    bool isOccluded(float x, float y, float z, float depth) {
-        // Check against all three spheres
-        // A point is occluded if there's another sphere point closer to camera
-        
-        // Simple occlusion test: check if point is inside another sphere that's closer
-        // Sphere 1 (closest in our view from the side)
-        if (isInsideSphere(x, y, z, 0.0f, SPHERE1_Y, 0.0f, SPHERE1_RADIUS)) {
-            // This point is on sphere 1's surface or inside
-            float dist1 = sqrt(x*x + (y-SPHERE1_Y)*(y-SPHERE1_Y) + z*z);
-            if (fabs(dist1 - SPHERE1_RADIUS) > 0.01f) {
-                // Inside sphere 1, check if it's actually on another sphere's surface
-                if (isInsideSphere(x, y, z, 0.0f, SPHERE2_Y, 0.0f, SPHERE2_RADIUS)) {
-                    float dist2 = sqrt(x*x + (y-SPHERE2_Y)*(y-SPHERE2_Y) + z*z);
-                    if (fabs(dist2 - SPHERE2_RADIUS) < 0.01f) return false; // On sphere 2 surface
+    // Surface points closer than this to the inside of another sphere are
+    // hidden inside the model
+    const float OCCLUSION_EPSILON = 0.01f;
+    
+    // Upper limit of occlusion grid cells per axis
+    const int GRID_MAX_CELLS = 64;
+    
+    void setDefaultSpheres() {
+        spheres.clear();
+        Sphere sphere3 = {0.0f, SPHERE3_Y, 0.0f, SPHERE3_RADIUS, 0.2f, 0.2f, 0.9f, 3};
+        Sphere sphere2 = {0.0f, SPHERE2_Y, 0.0f, SPHERE2_RADIUS, 0.2f, 0.9f, 0.2f, 2};
+        Sphere sphere1 = {0.0f, SPHERE1_Y, 0.0f, SPHERE1_RADIUS, 0.9f, 0.2f, 0.2f, 1};
+        spheres.push_back(sphere3);
+        spheres.push_back(sphere2);
+        spheres.push_back(sphere1);
+    }
+    
+    // Read spheres from a text file, one "x y z radius r g b" per line
+    // ('#' starts a comment)
+    bool loadSpheres(const char* filename) {
+        ifstream in(filename);
+        if (!in) {
+            cerr << "Error: Could not open sphere file " << filename << endl;
+            return false;
+        }
+        
+        vector<Sphere> loaded;
+        string line;
+        int lineNumber = 0;
+        while (getline(in, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == string::npos) {
+                continue;
+            }
+            istringstream fields(line);
+            Sphere sphere;
+            if (!(fields >> sphere.cx >> sphere.cy >> sphere.cz >> sphere.radius >> sphere.r >> sphere.g >> sphere.b) ||
+                sphere.radius <= 0.0f) {
+                cerr << "Error: " << filename << ":" << lineNumber << ": expected x y z radius r g b" << endl;
+                return false;
+            }
+            sphere.number = static_cast<int>(loaded.size()) + 1;
+            loaded.push_back(sphere);
+        }
+        if (loaded.empty()) {
+            cerr << "Error: No spheres in " << filename << endl;
+            return false;
+        }
+        
+        spheres = loaded;
+        return true;
+    }
+    
+    // Uniform grid over the bounding box of all spheres
+    // Every cell lists the spheres whose bounding box touches it, so a point
+    // is only tested against the spheres around it instead of all of them.
+    struct OcclusionGrid {
+        float minX, minY, minZ;
+        float invCellSize;
+        int nx, ny, nz;
+        vector<int> cellStart;      // spheres of cell c: cellSpheres[cellStart[c] .. cellStart[c + 1])
+        vector<int> cellSpheres;
+        vector<float> innerRadius2; // squared radius minus OCCLUSION_EPSILON, per sphere
+        
+        void build(const vector<Sphere>& list) {
+            float maxX, maxY, maxZ;
+            float radiusSum = 0.0f;
+            minX = minY = minZ = 1e30f;
+            maxX = maxY = maxZ = -1e30f;
+            innerRadius2.resize(list.size());
+            for (size_t s = 0; s < list.size(); s++) {
+                const Sphere& sphere = list[s];
+                minX = min(minX, sphere.cx - sphere.radius);
+                minY = min(minY, sphere.cy - sphere.radius);
+                minZ = min(minZ, sphere.cz - sphere.radius);
+                maxX = max(maxX, sphere.cx + sphere.radius);
+                maxY = max(maxY, sphere.cy + sphere.radius);
+                maxZ = max(maxZ, sphere.cz + sphere.radius);
+                radiusSum += sphere.radius;
+                float inner = max(sphere.radius - OCCLUSION_EPSILON, 0.0f);
+                innerRadius2[s] = inner * inner;
+            }
+            
+            // Cells about the size of an average sphere, so each cell holds
+            // a handful of spheres
+            float extent = max(maxX - minX, max(maxY - minY, maxZ - minZ));
+            float cellSize = max(radiusSum / list.size(), extent / GRID_MAX_CELLS);
+            invCellSize = 1.0f / cellSize;
+            nx = max(1, (int)ceil((maxX - minX) * invCellSize));
+            ny = max(1, (int)ceil((maxY - minY) * invCellSize));
+            nz = max(1, (int)ceil((maxZ - minZ) * invCellSize));
+            
+            // Count, then fill the sphere lists of all cells
+            vector<int> count(nx * ny * nz + 1, 0);
+            for (int pass = 0; pass < 2; pass++) {
+                if (pass == 1) {
+                    cellStart.assign(count.size(), 0);
+                    for (size_t c = 1; c < count.size(); c++) {
+                        cellStart[c] = cellStart[c - 1] + count[c - 1];
+                    }
+                    cellSpheres.resize(cellStart.back());
+                    fill(count.begin(), count.end(), 0);
                 }
-                if (isInsideSphere(x, y, z, 0.0f, SPHERE3_Y, 0.0f, SPHERE3_RADIUS)) {
-                    float dist3 = sqrt(x*x + (y-SPHERE3_Y)*(y-SPHERE3_Y) + z*z);
-                    if (fabs(dist3 - SPHERE3_RADIUS) < 0.01f) return false; // On sphere 3 surface
+                for (size_t s = 0; s < list.size(); s++) {
+                    const Sphere& sphere = list[s];
+                    int x0 = cellX(sphere.cx - sphere.radius), x1 = cellX(sphere.cx + sphere.radius);
+                    int y0 = cellY(sphere.cy - sphere.radius), y1 = cellY(sphere.cy + sphere.radius);
+                    int z0 = cellZ(sphere.cz - sphere.radius), z1 = cellZ(sphere.cz + sphere.radius);
+                    for (int z = z0; z <= z1; z++) {
+                        for (int y = y0; y <= y1; y++) {
+                            for (int x = x0; x <= x1; x++) {
+                                int c = (z * ny + y) * nx + x;
+                                if (pass == 1) {
+                                    cellSpheres[cellStart[c] + count[c]] = (int)s;
+                                }
+                                count[c]++;
+                            }
+                        }
+                    }
                 }
-                return true; // Inside sphere 1 but not on surface of others
             }
         }
         
-        return false; // Not occluded
-    }
+        int cellX(float x) const {
+            return min(nx - 1, max(0, (int)((x - minX) * invCellSize)));
+        }
+        int cellY(float y) const {
+            return min(ny - 1, max(0, (int)((y - minY) * invCellSize)));
+        }
+        int cellZ(float z) const {
+            return min(nz - 1, max(0, (int)((z - minZ) * invCellSize)));
+        }
+        
+        // Check whether a surface point of sphere `own` lies inside another
+        // sphere (squared distances only)
+        bool isOccluded(const vector<Sphere>& list, float x, float y, float z, int own) const {
+            int c = (cellZ(z) * ny + cellY(y)) * nx + cellX(x);
+            for (int k = cellStart[c]; k < cellStart[c + 1]; k++) {
+                int s = cellSpheres[k];
+                if (s == own) {
+                    continue;
+                }
+                float dx = x - list[s].cx;
+                float dy = y - list[s].cy;
+                float dz = z - list[s].cz;
+                if (dx*dx + dy*dy + dz*dz < innerRadius2[s]) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
     
-    // Generate vertices for a sphere with pixel-level granularity
-    void generateSphereVertices(float cx, float cy, float cz, float radius, 
-                                float r, float g, float b, int sphereId) {
+    // Number of latitude rings (minus one) of a sphere; longitude uses
+    // twice as many segments
+    int sphereSegments(float radius) {
         // Calculate number of subdivisions to achieve ~1 pixel per vertex
         // Approximate based on radius and screen projection
         int segments = (int)(radius * 200); // Adjust multiplier for density
         if (segments < 50) segments = 50;
         if (segments > 500) segments = 500;
+        return segments;
+    }
+    
+    // Generate the visible vertices of one latitude ring of a sphere
+    void generateRing(int sphereId, int ring, const OcclusionGrid& grid,
+                      const vector<float>& cosPhi, const vector<float>& sinPhi, vector<Vertex>& out) {
+        const Sphere& sphere = spheres[sphereId];
+        int segments = sphereSegments(sphere.radius);
+        float theta = M_PI * ring / segments; // 0 to PI
+        float ringRadius = sphere.radius * sin(theta);
+        float y = sphere.cy + sphere.radius * cos(theta);
         
-        // Generate points using spherical coordinates
-        for (int i = 0; i <= segments; i++) {
-            float theta = M_PI * i / segments; // 0 to PI
+        out.reserve(2 * segments + 1);
+        for (int j = 0; j <= segments * 2; j++) {
+            // Calculate sphere surface point
+            float x = sphere.cx + ringRadius * cosPhi[j];
+            float z = sphere.cz + ringRadius * sinPhi[j];
             
-            for (int j = 0; j <= segments * 2; j++) {
-                float phi = 2.0f * M_PI * j / (segments * 2); // 0 to 2PI
-                
-                // Calculate sphere surface point
-                float x = cx + radius * sin(theta) * cos(phi);
-                float y = cy + radius * cos(theta);
-                float z = cz + radius * sin(theta) * sin(phi);
-                
-                // Check if this vertex is occluded (skip internal overlapping vertices)
-                if (!isOccluded(x, y, z, z)) {
-                    Vertex v;
-                    v.x = x;
-                    v.y = y;
-                    v.z = z;
-                    v.r = r;
-                    v.g = g;
-                    v.b = b;
-                    vertices.push_back(v);
-                }
+            // Skip vertices hidden inside another sphere
+            if (!grid.isOccluded(spheres, x, y, z, sphereId)) {
+                Vertex v;
+                v.x = x;
+                v.y = y;
+                v.z = z;
+                v.r = sphere.r;
+                v.g = sphere.g;
+                v.b = sphere.b;
+                out.push_back(v);
             }
         }
     }
@@ -108,40 +253,142 @@ namespace Spheres {
         vertices.clear();
         
         cout << "Generating point-based vertex model..." << endl;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
         
-        // Generate vertices for all three spheres
-        // Order matters - generate from back to front for proper depth
-        generateSphereVertices(0.0f, SPHERE3_Y, 0.0f, SPHERE3_RADIUS, 0.2f, 0.2f, 0.9f, 3);
-        generateSphereVertices(0.0f, SPHERE2_Y, 0.0f, SPHERE2_RADIUS, 0.2f, 0.9f, 0.2f, 2);
-        generateSphereVertices(0.0f, SPHERE1_Y, 0.0f, SPHERE1_RADIUS, 0.9f, 0.2f, 0.2f, 1);
+        OcclusionGrid grid;
+        grid.build(spheres);
         
-        cout << "Generated " << vertices.size() << " vertices" << endl;
+        // Work items are latitude rings of all spheres; the longitude
+        // sin/cos tables are shared by all spheres with the same density
+        struct Ring {
+            int sphereId;
+            int ring;
+        };
+        vector<Ring> rings;
+        vector<vector<float> > cosPhi(spheres.size()), sinPhi(spheres.size());
+        for (size_t s = 0; s < spheres.size(); s++) {
+            int segments = sphereSegments(spheres[s].radius);
+            for (int i = 0; i <= segments; i++) {
+                Ring ring = {(int)s, i};
+                rings.push_back(ring);
+            }
+            cosPhi[s].resize(2 * segments + 1);
+            sinPhi[s].resize(2 * segments + 1);
+            for (int j = 0; j <= segments * 2; j++) {
+                float phi = 2.0f * M_PI * j / (segments * 2); // 0 to 2PI
+                cosPhi[s][j] = cos(phi);
+                sinPhi[s][j] = sin(phi);
+            }
+        }
+        
+        // Rings are generated in parallel into their own lists and joined
+        // in order, so the model is the same for any thread count
+        vector<vector<Vertex> > ringVertices(rings.size());
+        atomic<size_t> nextRing(0);
+        int threadCount = max(1, (int)thread::hardware_concurrency());
+        vector<thread> workers;
+        for (int t = 0; t < threadCount; t++) {
+            workers.push_back(thread([&]() {
+                for (size_t r = nextRing++; r < rings.size(); r = nextRing++) {
+                    int s = rings[r].sphereId;
+                    generateRing(s, rings[r].ring, grid, cosPhi[s], sinPhi[s], ringVertices[r]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        
+        size_t total = 0;
+        for (size_t r = 0; r < rings.size(); r++) {
+            total += ringVertices[r].size();
+        }
+        vertices.reserve(total);
+        for (size_t r = 0; r < rings.size(); r++) {
+            vertices.insert(vertices.end(), ringVertices[r].begin(), ringVertices[r].end());
+        }
+        
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Generated " << vertices.size() << " vertices from " << spheres.size() << " spheres in "
+             << ms << " ms (" << threadCount << " threads, " << grid.nx << "x" << grid.ny << "x" << grid.nz
+             << " occlusion grid)" << endl;
+    }
+    
+    // Retained-mode copy of the model: positions and colors in separate,
+    // tightly packed arrays (12 + 4 bytes per vertex). They are uploaded
+    // once into buffer objects, or drawn from client memory as plain
+    // vertex arrays where buffer objects (OpenGL 1.5) are not available.
+    bool immediateMode = false;         // 'V' switches to glBegin/glEnd for comparison
+    bool useBufferObjects = false;
+    GLuint positionBuffer = 0;
+    GLuint colorBuffer = 0;
+    GLsizei uploadedCount = 0;
+    vector<GLfloat> positions;          // x, y, z per vertex
+    vector<GLubyte> colors;             // r, g, b, a per vertex
+    
+    bool glVersionAtLeast(int major, int minor) {
+        const char* version = (const char*)glGetString(GL_VERSION);
+        int haveMajor = 0, haveMinor = 0;
+        if (!version || sscanf(version, "%d.%d", &haveMajor, &haveMinor) != 2) {
+            return false;
+        }
+        return haveMajor > major || (haveMajor == major && haveMinor >= minor);
     }
     
-    void projectVertices() {
-        // Get current matrices for projection
-        GLdouble modelview[16];
-        GLdouble projection[16];
-        GLint viewport[4];
+    // Pack the vertex model and upload it; needs a current GL context
+    void uploadVertices() {
+        uploadedCount = (GLsizei)vertices.size();
+        positions.resize(vertices.size() * 3);
+        colors.resize(vertices.size() * 4);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            positions[i * 3 + 0] = vertices[i].x;
+            positions[i * 3 + 1] = vertices[i].y;
+            positions[i * 3 + 2] = vertices[i].z;
+            colors[i * 4 + 0] = (GLubyte)(vertices[i].r * 255.0f + 0.5f);
+            colors[i * 4 + 1] = (GLubyte)(vertices[i].g * 255.0f + 0.5f);
+            colors[i * 4 + 2] = (GLubyte)(vertices[i].b * 255.0f + 0.5f);
+            colors[i * 4 + 3] = 255;
+        }
         
-        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-        glGetDoublev(GL_PROJECTION_MATRIX, projection);
-        glGetIntegerv(GL_VIEWPORT, viewport);
+        useBufferObjects = glVersionAtLeast(1, 5);
+        if (!useBufferObjects) {
+            return;
+        }
+        if (!positionBuffer) {
+            glGenBuffers(1, &positionBuffer);
+            glGenBuffers(1, &colorBuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+        glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLubyte), colors.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
         
-        // Project all vertices to screen coordinates
-        for (size_t i = 0; i < vertices.size(); i++) {
-            gluProject(vertices[i].x, vertices[i].y, vertices[i].z,
-                      modelview, projection, viewport,
-                      &vertices[i].screenX, &vertices[i].screenY, &vertices[i].screenZ);
+        // The driver keeps its own copy
+        vector<GLfloat>().swap(positions);
+        vector<GLubyte>().swap(colors);
+    }
+    
+    // Draw the uploaded model with a single glDrawArrays call
+    void drawBuffers() {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        if (useBufferObjects) {
+            glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+            glVertexPointer(3, GL_FLOAT, 0, 0);
+            glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, 0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        } else {
+            glVertexPointer(3, GL_FLOAT, 0, positions.data());
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, colors.data());
         }
+        glDrawArrays(GL_POINTS, 0, uploadedCount);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
     }
     
-    void drawAll() {
-        // Project vertices for this frame
-        projectVertices();
-        
-        // Draw all vertices as points
-        glPointSize(2.0f);  // Adjust point size as needed
+    void drawImmediate() {
         glBegin(GL_POINTS);
         for (size_t i = 0; i < vertices.size(); i++) {
             glColor3f(vertices[i].r, vertices[i].g, vertices[i].b);
@@ -150,11 +397,41 @@ namespace Spheres {
         glEnd();
     }
     
-    void exportVertices(const char* filename) {
+    void drawAll() {
+        // Draw all vertices as points
+        glPointSize(2.0f);  // Adjust point size as needed
+        if (immediateMode) {
+            drawImmediate();
+        } else {
+            drawBuffers();
+        }
+    }
+    
+    // What 'E' writes: text (vertices.txt) or binary (vertices.c64v)
+    enum ExportFormat {
+        EXPORT_TEXT,
+        EXPORT_BINARY,
+        EXPORT_QUANTIZED,
+    };
+    ExportFormat exportFormat = EXPORT_TEXT;
+    
+    void exportText(const char* filename) {
         // Export vertices to file for external use
         FILE* f = fopen(filename, "w");
         if (!f) return;
         
+        // Project with the matrices of the current frame; screen
+        // coordinates are only needed here, not for drawing
+        Projection projection;
+        projection_from_gl(&projection);
+        
+        size_t count = vertices.size();
+        vector<float> screenX(count), screenY(count), screenZ(count);
+        if (count > 0) {
+            project_vertices(projection, &vertices[0].x, sizeof(Vertex) / sizeof(float), (int)count,
+                             &screenX[0], &screenY[0], &screenZ[0]);
+        }
+        
         fprintf(f, "# Three Spheres Vertex Model\n");
         fprintf(f, "# Format: x y z r g b screenX screenY screenZ\n");
         fprintf(f, "# Total vertices: %zu\n\n", vertices.size());
@@ -163,11 +440,85 @@ namespace Spheres {
             fprintf(f, "%f %f %f %f %f %f %f %f %f\n",
                    vertices[i].x, vertices[i].y, vertices[i].z,
                    vertices[i].r, vertices[i].g, vertices[i].b,
-                   vertices[i].screenX, vertices[i].screenY, vertices[i].screenZ);
+                   screenX[i], screenY[i], screenZ[i]);
         }
         
         fclose(f);
-        cout << "Exported vertices to " << filename << endl;
+    }
+    
+    bool exportBinary(const char* filename, bool quantized) {
+        Projection projection;
+        projection_from_gl(&projection);
+        
+        // Split the model into the attribute arrays of the file
+        size_t count = vertices.size();
+        vector<float> x(count), y(count), z(count);
+        vector<unsigned char> red(count), green(count), blue(count);
+        for (size_t i = 0; i < count; i++) {
+            x[i] = vertices[i].x;
+            y[i] = vertices[i].y;
+            z[i] = vertices[i].z;
+            red[i] = (unsigned char)(vertices[i].r * 255.0f + 0.5f);
+            green[i] = (unsigned char)(vertices[i].g * 255.0f + 0.5f);
+            blue[i] = (unsigned char)(vertices[i].b * 255.0f + 0.5f);
+        }
+        
+        vector<float> screenX(count), screenY(count), screenZ(count);
+        vector<int16_t> pixelX, pixelY;
+        vector<uint16_t> depth;
+        if (count > 0) {
+            project_vertices(projection, &vertices[0].x, sizeof(Vertex) / sizeof(float), (int)count,
+                             &screenX[0], &screenY[0], &screenZ[0]);
+            if (quantized) {
+                pixelX.resize(count);
+                pixelY.resize(count);
+                depth.resize(count);
+                project_vertices_c64(projection, &vertices[0].x, sizeof(Vertex) / sizeof(float), (int)count,
+                                     0, 0, &pixelX[0], &pixelY[0], NULL);
+                for (size_t i = 0; i < count; i++) {
+                    depth[i] = quantize_depth(screenZ[i]);
+                }
+            }
+        }
+        
+        VertexFile file;
+        file.count = (uint32_t)count;
+        file.quantized = quantized;
+        for (int i = 0; i < 4; i++) {
+            file.viewport[i] = projection.viewport[i];
+        }
+        file.x = x.data();
+        file.y = y.data();
+        file.z = z.data();
+        if (quantized) {
+            file.pixel_x = pixelX.data();
+            file.pixel_y = pixelY.data();
+            file.depth = depth.data();
+        } else {
+            file.screen_x = screenX.data();
+            file.screen_y = screenY.data();
+            file.screen_z = screenZ.data();
+        }
+        file.red = red.data();
+        file.green = green.data();
+        file.blue = blue.data();
+        return write_vertex_file(filename, file);
+    }
+    
+    bool exportVertices() {
+        const char* filename = exportFormat == EXPORT_TEXT ? "vertices.txt" : "vertices.c64v";
+        auto start = chrono::steady_clock::now();
+        
+        if (exportFormat == EXPORT_TEXT) {
+            exportText(filename);
+        } else if (!exportBinary(filename, exportFormat == EXPORT_QUANTIZED)) {
+            cerr << "Could not write " << filename << endl;
+            return false;
+        }
+        
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Exported " << vertices.size() << " vertices to " << filename << " in " << ms << " ms" << endl;
+        return true;
     }
 }
 
@@ -186,7 +537,7 @@ void display() {
     // Draw all vertices as points
     Spheres::drawAll();
     
-    glutSwapBuffers();
+    present_frame();
 }
 
 void reshape(int w, int h) {
@@ -200,7 +551,13 @@ void reshape(int w, int h) {
 void keyboard(unsigned char key, int x, int y) {
     if (key == 'e' || key == 'E') {
         // Export vertices when 'e' is pressed
-        Spheres::exportVertices("vertices.txt");
+        Spheres::exportVertices();
+    } else if (key == 'v' || key == 'V') {
+        // Compare retained and immediate mode drawing
+        Spheres::immediateMode = !Spheres::immediateMode;
+        cout << "Drawing with " << (Spheres::immediateMode ? "glBegin/glEnd (immediate mode)" :
+                                    Spheres::useBufferObjects ? "buffer objects" : "vertex arrays") << endl;
+        glutPostRedisplay();
     } else if (key == 27) {  // ESC key
         exit(0);
     }
@@ -221,22 +578,73 @@ void init() {
     // Set background color
     glClearColor(0.1, 0.1, 0.15, 1.0);
     
-    // Generate the vertex model
+    // Generate the vertex model and hand it to OpenGL
     Spheres::generateAllVertices();
+    Spheres::uploadVertices();
     
     cout << "\nThree Spheres Point-Based Vertex Model initialized!" << endl;
-    cout << "Sphere 1: Radius = " << Spheres::SPHERE1_RADIUS << ", Y position = " << Spheres::SPHERE1_Y << endl;
-    cout << "  - Y range: " << (Spheres::SPHERE1_Y - Spheres::SPHERE1_RADIUS) << " to " << (Spheres::SPHERE1_Y + Spheres::SPHERE1_RADIUS) << endl;
-    cout << "Sphere 2: Radius = " << Spheres::SPHERE2_RADIUS << ", Y position = " << Spheres::SPHERE2_Y << endl;
-    cout << "  - Y range: " << (Spheres::SPHERE2_Y - Spheres::SPHERE2_RADIUS) << " to " << (Spheres::SPHERE2_Y + Spheres::SPHERE2_RADIUS) << endl;
-    cout << "Sphere 3: Radius = " << Spheres::SPHERE3_RADIUS << ", Y position = " << Spheres::SPHERE3_Y << endl;
-    cout << "  - Y range: " << (Spheres::SPHERE3_Y - Spheres::SPHERE3_RADIUS) << " to " << (Spheres::SPHERE3_Y + Spheres::SPHERE3_RADIUS) << endl;
+    if (Spheres::spheres.size() <= 8) {
+        // By number, not in generation order (the defaults are generated 3, 2, 1)
+        for (size_t s = 0; s < Spheres::spheres.size(); s++) {
+            const Spheres::Sphere& sphere = *find_if(Spheres::spheres.begin(), Spheres::spheres.end(),
+                [s](const Spheres::Sphere& other) { return other.number == static_cast<int>(s) + 1; });
+            cout << "Sphere " << sphere.number << ": Radius = " << sphere.radius << ", Y position = " << sphere.cy << endl;
+            cout << "  - Y range: " << (sphere.cy - sphere.radius) << " to " << (sphere.cy + sphere.radius) << endl;
+        }
+    }
+    cout << "Drawing with " << (Spheres::useBufferObjects ? "buffer objects" : "vertex arrays")
+         << " (" << Spheres::uploadedCount * (3 * sizeof(GLfloat) + 4) / 1024 << " KB)" << endl;
     cout << "\nPress 'E' to export vertices to file" << endl;
+    cout << "Press 'V' to switch between retained and immediate mode drawing" << endl;
     cout << "Press 'ESC' to exit" << endl;
 }
 
+// Headless runs render the model and then export it
+bool finishHeadless() {
+    return Spheres::exportVertices();
+}
+
 int main(int argc, char** argv) {
-    glutInit(&argc, argv);
+    // --headless FRAMES renders without a window, see c64_headless.h
+    HeadlessOptions headless;
+    if (!parse_headless_args(&argc, argv, &headless)) {
+        return 1;
+    }
+    if (headless.frames == 0) {
+        glutInit(&argc, argv);
+    }
+    
+    // Optional sphere file replaces the three default spheres
+    Spheres::setDefaultSpheres();
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--spheres" && i + 1 < argc) {
+            if (!Spheres::loadSpheres(argv[++i])) {
+                return 1;
+            }
+        } else if (string(argv[i]) == "--export" && i + 1 < argc) {
+            string format = argv[++i];
+            if (format == "text") {
+                Spheres::exportFormat = Spheres::EXPORT_TEXT;
+            } else if (format == "binary") {
+                Spheres::exportFormat = Spheres::EXPORT_BINARY;
+            } else if (format == "quantized") {
+                Spheres::exportFormat = Spheres::EXPORT_QUANTIZED;
+            } else {
+                cerr << "Unknown export format: " << format << " (text, binary or quantized)" << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Usage: " << argv[0] << " [--spheres FILE] [--export text|binary|quantized]"
+                 << " [--headless FRAMES [--capture PREFIX]]" << endl;
+            return 1;
+        }
+    }
+    
+    if (headless.frames > 0) {
+        HeadlessScene scene = {reshape, init, display, NULL, finishHeadless};
+        return run_headless(headless, 800, 600, scene);
+    }
+    
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
     glutCreateWindow("Three Spheres - GL_POINTS Vertex Model");